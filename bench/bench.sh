@@ -0,0 +1,74 @@
+#!/bin/sh
+# Pruebas de rendimiento de kaio y de e1-e4 sobre entradas sintéticas.
+# Cada herramienta se mide en frío (entrada expulsada de la caché de páginas)
+# y en caliente (después de una pasada previa). El resultado es un CSV:
+#   herramienta,entrada,cache,bytes,segundos,usuario,sistema,fallos_menores,fallos_mayores,rss_max_kib,mb_s
+#
+# Variables: TAM (por defecto 16M), DIR (archivos temporales), SALIDA (CSV,
+# por defecto la salida estándar), HILOS (para kaio -j, por defecto nproc).
+# e1 lee byte a byte con read(), así que conviene no subir mucho TAM.
+
+set -e
+
+RAIZ=$(cd "$(dirname "$0")/.." && pwd)
+TAM=${TAM:-16M}
+DIR=${DIR:-/tmp/kaio-bench}
+SALIDA=${SALIDA:-/dev/stdout}
+HILOS=${HILOS:-$(nproc)}
+
+mkdir -p "$DIR"
+
+# nombre:%letras:%digitos:pesos de los dígitos 0-9
+ENTRADAS="
+texto:90:5:1,1,1,1,1,1,1,1,1,1
+mixto:60:30:1,1,1,1,1,1,1,1,1,1
+digitos:5:90:1,1,1,1,1,1,1,1,1,1
+nueves:20:70:0,0,0,0,0,0,0,0,0,1
+"
+
+# etiqueta|orden para bench/medir (ENTRADA, SALIDA_K y COPIA se sustituyen al ejecutar)
+HERRAMIENTAS="
+kaio|./kaio ENTRADA SALIDA_K
+kaio-j|./kaio -j $HILOS ENTRADA SALIDA_K
+kaio-hilos|./kaio --hilos ENTRADA SALIDA_K
+kaio-j-hilos|./kaio --hilos -j $HILOS ENTRADA SALIDA_K
+kaio-m64|./kaio -m 64 ENTRADA SALIDA_K
+kaio-uring|./kaio --io=uring ENTRADA SALIDA_K
+kaio-tuberia|-i ENTRADA -o SALIDA_K ./kaio - -
+e1|./e1 ENTRADA
+e2|./e2 COPIA
+e3|./e3 ENTRADA
+e4|./e4 ENTRADA
+"
+
+echo "herramienta,entrada,cache,bytes,segundos,usuario,sistema,fallos_menores,fallos_mayores,rss_max_kib,mb_s" > "$SALIDA"
+
+cd "$RAIZ"
+for e in $ENTRADAS; do
+    nombre=${e%%:*}; resto=${e#*:}
+    letras=${resto%%:*}; resto=${resto#*:}
+    digitos=${resto%%:*}; pesos=${resto#*:}
+
+    entrada="$DIR/$nombre.txt"
+    ./bench/generador -n "$TAM" -l "$letras" -d "$digitos" -p "$pesos" > "$entrada"
+    bytes=$(wc -c < "$entrada")
+
+    echo "$HERRAMIENTAS" | while IFS='|' read -r etiqueta orden; do
+        [ -n "$etiqueta" ] || continue
+        # e2 modifica su archivo: trabaja sobre una copia
+        cp "$entrada" "$DIR/copia.txt"
+        orden=$(echo "$orden" | sed -e "s|ENTRADA|$entrada|g" -e "s|SALIDA_K|$DIR/salida.txt|g" \
+                                    -e "s|COPIA|$DIR/copia.txt|g")
+        for cache in frio caliente; do
+            if [ "$cache" = frio ]; then
+                enfriar="-f $entrada -f $DIR/copia.txt"
+            else
+                enfriar=""
+                # shellcheck disable=SC2086
+                ./bench/medir $orden > /dev/null
+            fi
+            # shellcheck disable=SC2086
+            ./bench/medir -e "$etiqueta,$nombre,$cache" -b "$bytes" $enfriar $orden >> "$SALIDA"
+        done
+    done
+done
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>     // getopt
+
+// Generador de entradas sintéticas para las pruebas de rendimiento de kaio y
+// de e1-e4. Escribe en la salida estándar 'n' bytes con la composición pedida:
+// un porcentaje de letras, otro de dígitos (con su propia distribución de
+// valores) y el resto "otros" caracteres (espacios, puntuación, saltos de línea).
+
+#define TAM_BLOQUE (1 << 20)
+
+static const char letras[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+static const char otros[] = " \n.,;:-_()";
+
+// xorshift64*: rápido y suficiente para generar datos de prueba
+static uint64_t estado_aleatorio = 88172645463325252ULL;
+
+static uint64_t aleatorio(void) {
+    estado_aleatorio ^= estado_aleatorio >> 12;
+    estado_aleatorio ^= estado_aleatorio << 25;
+    estado_aleatorio ^= estado_aleatorio >> 27;
+    return estado_aleatorio * 2685821657736338717ULL;
+}
+
+// Acepta sufijos K, M y G (potencias de 1024)
+static size_t leer_tamaño(const char *texto) {
+    char *fin;
+    unsigned long long valor = strtoull(texto, &fin, 10);
+    switch (*fin) {
+    case 'G': case 'g': valor <<= 30; break;
+    case 'M': case 'm': valor <<= 20; break;
+    case 'K': case 'k': valor <<= 10; break;
+    }
+    return (size_t) valor;
+}
+
+// "w0,w1,...,w9": peso relativo de cada valor de dígito
+static int leer_pesos(const char *texto, unsigned pesos[10]) {
+    for (int d = 0; d < 10; d++) {
+        char *fin;
+        pesos[d] = (unsigned) strtoul(texto, &fin, 10);
+        if (fin == texto || (d < 9 && *fin != ',') || (d == 9 && *fin != '\0'))
+            return -1;
+        texto = fin + 1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    size_t n = 0;
+    unsigned porcentaje_letras = 80, porcentaje_digitos = 10;
+    unsigned pesos[10] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+
+    int opcion;
+    while ((opcion = getopt(argc, argv, "n:l:d:p:s:")) != -1) {
+        switch (opcion) {
+        case 'n': n = leer_tamaño(optarg); break;
+        case 'l': porcentaje_letras = (unsigned) atoi(optarg); break;
+        case 'd': porcentaje_digitos = (unsigned) atoi(optarg); break;
+        case 's': estado_aleatorio = strtoull(optarg, NULL, 10) | 1; break;
+        case 'p':
+            if (leer_pesos(optarg, pesos) < 0) {
+                fprintf(stderr, "Los pesos de los dígitos son diez enteros separados por comas.\n");
+                return 1;
+            }
+            break;
+        default:
+            n = 0;
+            break;
+        }
+    }
+
+    if (n == 0 || porcentaje_letras + porcentaje_digitos > 100) {
+        fprintf(stderr, "Uso correcto: %s -n BYTES[K|M|G] [-l %%letras] [-d %%digitos] "
+                        "[-p w0,...,w9] [-s semilla] > archivo\n", argv[0]);
+        return 1;
+    }
+
+    // tabla acumulada de pesos para elegir el valor de cada dígito
+    unsigned acumulado[10], total_pesos = 0;
+    for (int d = 0; d < 10; d++) {
+        total_pesos += pesos[d];
+        acumulado[d] = total_pesos;
+    }
+    if (total_pesos == 0) {
+        fprintf(stderr, "Algún dígito debe tener peso mayor que 0.\n");
+        return 1;
+    }
+
+    char *bloque = malloc(TAM_BLOQUE);
+    if (bloque == NULL) {
+        perror("malloc");
+        return 1;
+    }
+
+    while (n > 0) {
+        size_t longitud = n < TAM_BLOQUE ? n : TAM_BLOQUE;
+        for (size_t i = 0; i < longitud; i++) {
+            uint64_t r = aleatorio();
+            unsigned clase = (unsigned) (r % 100);
+            r >>= 8;
+            if (clase < porcentaje_letras) {
+                bloque[i] = letras[r % (sizeof(letras) - 1)];
+            } else if (clase < porcentaje_letras + porcentaje_digitos) {
+                unsigned elegido = (unsigned) (r % total_pesos);
+                int d = 0;
+                while (acumulado[d] <= elegido)
+                    d++;
+                bloque[i] = (char) ('0' + d);
+            } else {
+                bloque[i] = otros[r % (sizeof(otros) - 1)];
+            }
+        }
+        if (fwrite(bloque, 1, longitud, stdout) != longitud) {
+            perror("fwrite");
+            free(bloque);
+            return 1;
+        }
+        n -= longitud;
+    }
+
+    free(bloque);
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+// Ejecuta un programa y escribe una línea CSV con lo que ha costado:
+//   etiqueta,bytes,segundos,usuario,sistema,fallos_menores,fallos_mayores,rss_max_kib,mb_s
+// Los recursos son los del programa y de todos los hijos que él haya esperado
+// (kaio espera a sus trabajadores). Con -f se expulsa antes un archivo de la
+// caché de páginas para medir en frío. Por defecto la salida estándar del
+// programa se descarta y su entrada estándar es /dev/null (así e3 y e4 no se
+// quedan parados); -i y -o las redirigen a archivos.
+
+static double segundos(struct timeval t) {
+    return (double) t.tv_sec + (double) t.tv_usec / 1e6;
+}
+
+// Vacía las páginas sucias del archivo y lo saca de la caché de páginas
+static int enfriar(const char *archivo) {
+    int fd = open(archivo, O_RDONLY);
+    if (fd < 0) {
+        perror(archivo);
+        return -1;
+    }
+    fdatasync(fd);
+    int r = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+    return r == 0 ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    const char *etiqueta = "";
+    unsigned long long bytes = 0;
+    const char *entrada = "/dev/null", *salida = "/dev/null";
+
+    int opcion;
+    while ((opcion = getopt(argc, argv, "+e:b:f:i:o:")) != -1) {
+        switch (opcion) {
+        case 'e': etiqueta = optarg; break;
+        case 'b': bytes = strtoull(optarg, NULL, 10); break;
+        case 'i': entrada = optarg; break;
+        case 'o': salida = optarg; break;
+        case 'f':
+            if (enfriar(optarg) < 0)
+                return 1;
+            break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+
+    if (optind >= argc) {
+        fprintf(stderr, "Uso correcto: %s [-e etiqueta] [-b bytes] [-f archivo_a_enfriar]... "
+                        "[-i entrada] [-o salida] programa [argumentos...]\n", argv[0]);
+        return 1;
+    }
+
+    struct timespec inicio, fin;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    } else if (pid == 0) {
+        int fd_entrada = open(entrada, O_RDONLY);
+        int fd_salida = open(salida, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_entrada < 0 || fd_salida < 0) {
+            perror("open");
+            _exit(127);
+        }
+        dup2(fd_entrada, STDIN_FILENO);
+        dup2(fd_salida, STDOUT_FILENO);
+        close(fd_entrada);
+        close(fd_salida);
+        execvp(argv[optind], &argv[optind]);
+        perror("execvp");
+        _exit(127);
+    }
+
+    int estado;
+    struct rusage uso;
+    if (wait4(pid, &estado, 0, &uso) < 0) {
+        perror("wait4");
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &fin);
+
+    double transcurrido = (double) (fin.tv_sec - inicio.tv_sec) + (double) (fin.tv_nsec - inicio.tv_nsec) / 1e9;
+    printf("%s,%llu,%.4f,%.4f,%.4f,%ld,%ld,%ld,%.1f\n", etiqueta, bytes, transcurrido,
+           segundos(uso.ru_utime), segundos(uso.ru_stime), uso.ru_minflt, uso.ru_majflt, uso.ru_maxrss,
+           transcurrido > 0 ? (double) bytes / 1048576.0 / transcurrido : 0.0);
+
+    if (!WIFEXITED(estado) || WEXITSTATUS(estado) != 0) {
+        fprintf(stderr, "%s: el programa terminó con error\n", etiqueta);
+        return 1;
+    }
+    return 0;
+}
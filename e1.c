@@ -1,33 +1,224 @@
+#define _GNU_SOURCE // para splice
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include <sys/stat.h>
 #include <fcntl.h> // para O_RDONLY
 #include <sys/mman.h> // para mmap
+#include <unistd.h> // para read, close
+#include <time.h> // para clock_gettime
+#include <sys/resource.h> // para getrusage
+#include <sys/sendfile.h> // para sendfile
 
-int main(int argc, char *argv[]){
+// Sin opciones, e1 vuelca el archivo dos veces: con read() de 1 byte y con mmap.
+// Con -m mide estrategias de lectura y escribe una línea CSV por medición:
+//   modo,buffer,bytes,segundos,mb_s,llamadas,fallos_menores,fallos_mayores,suma
+// 'llamadas' son las llamadas al sistema de E/S que hace e1 (read, pread,
+// sendfile, splice, mmap, madvise...). 'suma' es la suma de todos los bytes
+// leídos: obliga a tocar los datos y comprueba que todos los modos leen lo mismo
+// (sendfile y splice no pasan los datos por el proceso, su suma es 0).
 
-    if(argc < 2){
-        fprintf(stderr, "Formato invalido. Uso: %s <Nombre_Archivo>\n", argv[0]);
-        return 1;
+#define MAX_BUFFERS 16
+
+struct medicion {
+    size_t bytes;
+    unsigned long llamadas;
+    uint64_t suma;
+};
+
+static double ahora(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec + (double) t.tv_nsec / 1e9;
+}
+
+static uint64_t sumar(const unsigned char *datos, size_t n) {
+    uint64_t suma = 0;
+    for (size_t i = 0; i < n; i++)
+        suma += datos[i];
+    return suma;
+}
+
+// Saca el archivo de la caché de páginas para medir lecturas desde disco
+static void enfriar(int archivo) {
+    posix_fadvise(archivo, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+// read() con un buffer de 'tam_buffer' bytes
+static int medir_read(int archivo, size_t tam_buffer, struct medicion *m) {
+    unsigned char *buffer = malloc(tam_buffer);
+    if (buffer == NULL) {
+        perror("malloc");
+        return -1;
     }
-    
-    int archivo = open(argv[1], O_RDONLY);
-    if (archivo == -1) {
-        perror("open");
-        return 1;
+    lseek(archivo, 0, SEEK_SET);
+    m->llamadas++;
+    ssize_t leidos;
+    while ((leidos = read(archivo, buffer, tam_buffer)) > 0) {
+        m->llamadas++;
+        m->bytes += (size_t) leidos;
+        m->suma += sumar(buffer, (size_t) leidos);
+    }
+    m->llamadas++; // la lectura que devuelve 0 (o el error)
+    free(buffer);
+    if (leidos < 0) {
+        perror("read");
+        return -1;
     }
+    return 0;
+}
 
-    // Buffer para fstat
-    struct stat st;
-    if (fstat(archivo, &st) == -1) {
-        perror("fstat");
-        close(archivo);
-        return 1;
+// pread() con avisos al kernel: lectura secuencial y todo el archivo se necesitará
+static int medir_pread(int archivo, size_t tamaño, size_t tam_buffer, struct medicion *m) {
+    unsigned char *buffer = malloc(tam_buffer);
+    if (buffer == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    posix_fadvise(archivo, 0, 0, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(archivo, 0, 0, POSIX_FADV_WILLNEED);
+    m->llamadas += 2;
+    off_t offset = 0;
+    while ((size_t) offset < tamaño) {
+        ssize_t leidos = pread(archivo, buffer, tam_buffer, offset);
+        m->llamadas++;
+        if (leidos < 0) {
+            perror("pread");
+            free(buffer);
+            return -1;
+        }
+        if (leidos == 0)
+            break;
+        m->bytes += (size_t) leidos;
+        m->suma += sumar(buffer, (size_t) leidos);
+        offset += leidos;
     }
-    printf("Tamaño del archivo: %ld bytes\n", st.st_size);
-    
+    free(buffer);
+    return 0;
+}
+
+// mmap de todo el archivo; 'variante' 0: sin avisos, 1: madvise, 2: MAP_POPULATE
+static int medir_mmap(int archivo, size_t tamaño, int variante, struct medicion *m) {
+    int flags = MAP_PRIVATE | (variante == 2 ? MAP_POPULATE : 0);
+    unsigned char *map = mmap(NULL, tamaño, PROT_READ, flags, archivo, 0);
+    m->llamadas++;
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    if (variante == 1) {
+        madvise(map, tamaño, MADV_SEQUENTIAL);
+        madvise(map, tamaño, MADV_WILLNEED);
+        m->llamadas += 2;
+    }
+    m->bytes = tamaño;
+    m->suma = sumar(map, tamaño);
+    munmap(map, tamaño);
+    m->llamadas++;
+    return 0;
+}
+
+// sendfile() del archivo al destino, sin pasar por memoria del proceso
+static int medir_sendfile(int archivo, size_t tamaño, int destino, struct medicion *m) {
+    off_t offset = 0;
+    while ((size_t) offset < tamaño) {
+        ssize_t enviados = sendfile(destino, archivo, &offset, tamaño - (size_t) offset);
+        m->llamadas++;
+        if (enviados < 0) {
+            perror("sendfile");
+            return -1;
+        }
+        if (enviados == 0)
+            break;
+        m->bytes += (size_t) enviados;
+    }
+    return 0;
+}
+
+// splice() archivo -> tubería -> destino (splice necesita una tubería en un extremo)
+static int medir_splice(int archivo, size_t tamaño, int destino, struct medicion *m) {
+    int tubo[2];
+    if (pipe(tubo) < 0) {
+        perror("pipe");
+        return -1;
+    }
+    m->llamadas++;
+    loff_t offset = 0;
+    int resultado = 0;
+    while ((size_t) offset < tamaño) {
+        ssize_t en_tubo = splice(archivo, &offset, tubo[1], NULL, tamaño - (size_t) offset, SPLICE_F_MOVE);
+        m->llamadas++;
+        if (en_tubo <= 0) {
+            if (en_tubo < 0) {
+                perror("splice");
+                resultado = -1;
+            }
+            break;
+        }
+        while (en_tubo > 0) {
+            ssize_t sacados = splice(tubo[0], NULL, destino, NULL, (size_t) en_tubo, SPLICE_F_MOVE);
+            m->llamadas++;
+            if (sacados <= 0) {
+                perror("splice");
+                resultado = -1;
+                break;
+            }
+            en_tubo -= sacados;
+            m->bytes += (size_t) sacados;
+        }
+        if (resultado < 0)
+            break;
+    }
+    close(tubo[0]);
+    close(tubo[1]);
+    return resultado;
+}
+
+// Ejecuta una medición y escribe su línea CSV
+static int medir(const char *modo, size_t tam_buffer, int archivo, size_t tamaño, int destino, int frio) {
+    struct medicion m = { 0 };
+    struct rusage antes, despues;
+
+    if (frio)
+        enfriar(archivo);
+
+    getrusage(RUSAGE_SELF, &antes);
+    double inicio = ahora();
+
+    int resultado;
+    if (strcmp(modo, "read") == 0)
+        resultado = medir_read(archivo, tam_buffer, &m);
+    else if (strcmp(modo, "pread") == 0)
+        resultado = medir_pread(archivo, tamaño, tam_buffer, &m);
+    else if (strcmp(modo, "mmap") == 0)
+        resultado = medir_mmap(archivo, tamaño, 0, &m);
+    else if (strcmp(modo, "mmap-madvise") == 0)
+        resultado = medir_mmap(archivo, tamaño, 1, &m);
+    else if (strcmp(modo, "mmap-populate") == 0)
+        resultado = medir_mmap(archivo, tamaño, 2, &m);
+    else if (strcmp(modo, "sendfile") == 0)
+        resultado = medir_sendfile(archivo, tamaño, destino, &m);
+    else
+        resultado = medir_splice(archivo, tamaño, destino, &m);
+
+    double segundos = ahora() - inicio;
+    getrusage(RUSAGE_SELF, &despues);
+    if (resultado < 0)
+        return -1;
+
+    printf("%s,%zu,%zu,%.4f,%.1f,%lu,%ld,%ld,%llu\n", modo, tam_buffer, m.bytes, segundos,
+           segundos > 0 ? (double) m.bytes / 1048576.0 / segundos : 0.0, m.llamadas,
+           despues.ru_minflt - antes.ru_minflt, despues.ru_majflt - antes.ru_majflt,
+           (unsigned long long) m.suma);
+    fflush(stdout);
+    return 0;
+}
+
+// El programa original: volcado byte a byte con read() y después desde la proyección
+static int volcado(int archivo, size_t tamaño) {
     char c;
-    for (int i = 0; i < st.st_size; i++){ 
+    for (size_t i = 0; i < tamaño; i++){
         if (read(archivo, &c, 1) != 1) { //leemos 1 byte del archivo y lo guardamos en c
             perror("read"); // error
             close(archivo);
@@ -38,7 +229,7 @@ int main(int argc, char *argv[]){
 
     char *map = mmap(
         NULL,           // Dirección elegida por el kernel
-        st.st_size,     // Tamaño a mapear
+        tamaño,         // Tamaño a mapear
         PROT_READ,      // Permisos del mapping: Solo lectura
         MAP_PRIVATE,    // Tipo de mapeo: Area de memoria privada
         archivo,        // Descriptor de archivo
@@ -56,11 +247,134 @@ int main(int argc, char *argv[]){
     close(archivo);
 
     // Imprimir la proyección carácter a carácter
-    for (size_t i = 0; i < st.st_size; i++) {
+    for (size_t i = 0; i < tamaño; i++) {
         putchar(map[i]);
     }
 
     //Desmapeo/Desproyectar la memoria
-    munmap(map, st.st_size);
+    munmap(map, tamaño);
     return 0;
-}
\ No newline at end of file
+}
+
+static void uso(const char *programa) {
+    fprintf(stderr, "Formato invalido. Uso: %s [-m read|pread|mmap|sendfile|splice|todos] "
+                    "[-b tam1,tam2,...] [-o destino] [-f] <Nombre_Archivo>\n", programa);
+}
+
+int main(int argc, char *argv[]){
+    const char *modo = NULL;            // NULL: volcado original
+    const char *destino = "/dev/null";  // para sendfile y splice
+    int frio = 0;
+    size_t buffers[MAX_BUFFERS] = { 4096, 16384, 65536, 262144, 1048576 };
+    int n_buffers = 5;
+
+    int opcion;
+    while ((opcion = getopt(argc, argv, "m:b:o:f")) != -1) {
+        switch (opcion) {
+        case 'm':
+            modo = optarg;
+            break;
+        case 'b': {
+            // lista de tamaños de buffer para read y pread, separados por comas
+            char *resto = optarg;
+            n_buffers = 0;
+            while (*resto != '\0') {
+                if (n_buffers == MAX_BUFFERS) {
+                    fprintf(stderr, "Como mucho %d tamaños de buffer en -b.\n", MAX_BUFFERS);
+                    return 1;
+                }
+                buffers[n_buffers] = strtoull(resto, &resto, 10);
+                if (buffers[n_buffers] == 0 || (*resto != ',' && *resto != '\0')) {
+                    uso(argv[0]);
+                    return 1;
+                }
+                n_buffers++;
+                if (*resto == ',')
+                    resto++;
+            }
+            break;
+        }
+        case 'o':
+            destino = optarg;
+            break;
+        case 'f':
+            frio = 1;
+            break;
+        default:
+            uso(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind != argc - 1 || n_buffers == 0){
+        uso(argv[0]);
+        return 1;
+    }
+
+    int archivo = open(argv[optind], O_RDONLY);
+    if (archivo == -1) {
+        perror("open");
+        return 1;
+    }
+
+    // Buffer para fstat
+    struct stat st;
+    if (fstat(archivo, &st) == -1) {
+        perror("fstat");
+        close(archivo);
+        return 1;
+    }
+    size_t tamaño = (size_t) st.st_size;
+
+    if (modo == NULL) {
+        printf("Tamaño del archivo: %ld bytes\n", st.st_size);
+        return volcado(archivo, tamaño);
+    }
+
+    int todos = strcmp(modo, "todos") == 0;
+    if (!todos && strcmp(modo, "read") != 0 && strcmp(modo, "pread") != 0 && strcmp(modo, "mmap") != 0 &&
+        strcmp(modo, "sendfile") != 0 && strcmp(modo, "splice") != 0) {
+        uso(argv[0]);
+        close(archivo);
+        return 1;
+    }
+
+    int fd_destino = -1;
+    if (todos || strcmp(modo, "sendfile") == 0 || strcmp(modo, "splice") == 0) {
+        fd_destino = open(destino, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd_destino == -1) {
+            perror("open destino");
+            close(archivo);
+            return 1;
+        }
+    }
+
+    int resultado = 0;
+    printf("modo,buffer,bytes,segundos,mb_s,llamadas,fallos_menores,fallos_mayores,suma\n");
+    for (int i = 0; i < n_buffers && resultado == 0 && (todos || strcmp(modo, "read") == 0); i++)
+        resultado = medir("read", buffers[i], archivo, tamaño, fd_destino, frio);
+    for (int i = 0; i < n_buffers && resultado == 0 && (todos || strcmp(modo, "pread") == 0); i++)
+        resultado = medir("pread", buffers[i], archivo, tamaño, fd_destino, frio);
+    if (resultado == 0 && tamaño > 0 && (todos || strcmp(modo, "mmap") == 0)) {
+        resultado = medir("mmap", 0, archivo, tamaño, fd_destino, frio);
+        if (resultado == 0)
+            resultado = medir("mmap-madvise", 0, archivo, tamaño, fd_destino, frio);
+        if (resultado == 0)
+            resultado = medir("mmap-populate", 0, archivo, tamaño, fd_destino, frio);
+    }
+    if (resultado == 0 && (todos || strcmp(modo, "sendfile") == 0)) {
+        if (ftruncate(fd_destino, 0) == 0) // si el destino es un archivo, empezamos de cero
+            lseek(fd_destino, 0, SEEK_SET);
+        resultado = medir("sendfile", 0, archivo, tamaño, fd_destino, frio);
+    }
+    if (resultado == 0 && (todos || strcmp(modo, "splice") == 0)) {
+        if (ftruncate(fd_destino, 0) == 0)
+            lseek(fd_destino, 0, SEEK_SET);
+        resultado = medir("splice", 0, archivo, tamaño, fd_destino, frio);
+    }
+
+    if (fd_destino != -1)
+        close(fd_destino);
+    close(archivo);
+    return resultado == 0 ? 0 : 1;
+}
@@ -1,19 +1,282 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include <sys/stat.h>
 #include <fcntl.h>      // open
 #include <sys/mman.h>   // mmap
-#include <unistd.h>     // read, close
+#include <unistd.h>     // read, close, getopt
+#include <time.h>       // clock_gettime
+
+// Sin -p, e2 hace la demostración original: cambia el primer carácter del
+// archivo a través de la proyección compartida.
+// Con -p aplica un lote de parches, uno por línea, leídos de un archivo o de
+// la entrada estándar ('-'):
+//   <offset> <bytes en hexadecimal>      p. ej.  1024 48006c61
+//   <offset> =<texto hasta fin de línea> p. ej.  1024 =Hola
+// Solo se sincronizan las páginas modificadas, en rangos contiguos.
+// Durabilidad de los parches (-d, solo con -p): none (sin msync, el kernel
+// escribe cuando quiera), async (MS_ASYNC) o sync (MS_SYNC, por defecto).
+
+#define DURABILIDAD_NONE  0
+#define DURABILIDAD_ASYNC 1
+#define DURABILIDAD_SYNC  2
+
+struct parche {
+    size_t offset;
+    size_t longitud;
+    unsigned char *bytes;
+};
+
+static double ahora(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec + (double) t.tv_nsec / 1e9;
+}
+
+static int valor_hex(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Interpreta una línea de parche. Devuelve 0 si es válida, 1 si está vacía
+// o es un comentario ('#') y -1 si tiene un error de formato.
+static int leer_parche(char *linea, struct parche *p) {
+    size_t n = strlen(linea);
+    if (n > 0 && linea[n - 1] == '\n')
+        linea[--n] = '\0';
+    if (n == 0 || linea[0] == '#')
+        return 1;
+
+    char *resto;
+    p->offset = strtoull(linea, &resto, 10);
+    if (resto == linea || *resto != ' ')
+        return -1;
+    resto++;
+
+    if (*resto == '=') {
+        // texto literal
+        resto++;
+        p->longitud = strlen(resto);
+        if (p->longitud == 0)
+            return -1;
+        p->bytes = malloc(p->longitud + 1);
+        if (p->bytes == NULL)
+            return -1;
+        memcpy(p->bytes, resto, p->longitud);
+    } else {
+        size_t digitos = strlen(resto);
+        if (digitos == 0 || digitos % 2 != 0)
+            return -1;
+        p->longitud = digitos / 2;
+        p->bytes = malloc(p->longitud);
+        if (p->bytes == NULL)
+            return -1;
+        for (size_t i = 0; i < p->longitud; i++) {
+            int alto = valor_hex(resto[2 * i]), bajo = valor_hex(resto[2 * i + 1]);
+            if (alto < 0 || bajo < 0) {
+                free(p->bytes);
+                return -1;
+            }
+            p->bytes[i] = (unsigned char) (alto << 4 | bajo);
+        }
+    }
+    return 0;
+}
+
+// Lee todos los parches y comprueba que caben en el archivo antes de tocar nada
+static struct parche *leer_parches(const char *nombre, size_t tamaño, size_t *n_parches) {
+    FILE *f = strcmp(nombre, "-") == 0 ? stdin : fopen(nombre, "r");
+    if (f == NULL) {
+        perror("fopen parches");
+        return NULL;
+    }
+
+    size_t capacidad = 64, n = 0, numero_linea = 0;
+    struct parche *parches = malloc(capacidad * sizeof(struct parche));
+    char *linea = NULL;
+    size_t tam_linea = 0;
+    int error = parches == NULL;
+
+    while (!error && getline(&linea, &tam_linea, f) != -1) {
+        numero_linea++;
+        struct parche p;
+        int r = leer_parche(linea, &p);
+        if (r == 1)
+            continue;
+        if (r < 0 || p.offset > tamaño || p.longitud > tamaño - p.offset) {
+            fprintf(stderr, "Parche inválido o fuera del archivo en la línea %zu.\n", numero_linea);
+            if (r == 0)
+                free(p.bytes);
+            error = 1;
+            break;
+        }
+        if (n == capacidad) {
+            capacidad *= 2;
+            struct parche *nuevos = realloc(parches, capacidad * sizeof(struct parche));
+            if (nuevos == NULL) {
+                perror("realloc");
+                free(p.bytes);
+                error = 1;
+                break;
+            }
+            parches = nuevos;
+        }
+        parches[n++] = p;
+    }
+
+    free(linea);
+    if (f != stdin)
+        fclose(f);
+    if (error) {
+        for (size_t i = 0; i < n; i++)
+            free(parches[i].bytes);
+        free(parches);
+        return NULL;
+    }
+    *n_parches = n;
+    return parches;
+}
+
+// Aplica los parches sobre la proyección, sincroniza solo las páginas sucias
+// (agrupando las contiguas en un único msync) e informa de lo hecho
+static int aplicar_parches(char *map, size_t tamaño, const struct parche *parches, size_t n_parches,
+                           int durabilidad) {
+    size_t pagina = (size_t) sysconf(_SC_PAGESIZE);
+    size_t n_paginas = (tamaño + pagina - 1) / pagina;
+
+    // un bit por página del archivo: 1 si algún parche la ha modificado
+    uint64_t *sucias = calloc((n_paginas + 63) / 64, sizeof(uint64_t));
+    if (sucias == NULL) {
+        perror("calloc");
+        return -1;
+    }
+
+    double inicio = ahora();
+    size_t bytes = 0;
+    for (size_t i = 0; i < n_parches; i++) {
+        memcpy(map + parches[i].offset, parches[i].bytes, parches[i].longitud);
+        bytes += parches[i].longitud;
+        size_t primera = parches[i].offset / pagina;
+        size_t ultima = (parches[i].offset + parches[i].longitud - 1) / pagina;
+        for (size_t p = primera; p <= ultima; p++)
+            sucias[p / 64] |= 1ULL << (p % 64);
+    }
+    double fin_aplicar = ahora();
+
+    // recorremos el mapa de bits en rangos de páginas sucias consecutivas
+    size_t paginas_sucias = 0, rangos = 0;
+    int resultado = 0;
+    size_t p = 0;
+    while (p < n_paginas) {
+        if (!(sucias[p / 64] >> (p % 64) & 1)) {
+            p++;
+            continue;
+        }
+        size_t primera = p;
+        while (p < n_paginas && (sucias[p / 64] >> (p % 64) & 1))
+            p++;
+        paginas_sucias += p - primera;
+        rangos++;
+
+        if (durabilidad != DURABILIDAD_NONE) {
+            size_t longitud = (p - primera) * pagina;
+            if (primera * pagina + longitud > tamaño)
+                longitud = tamaño - primera * pagina;
+            int flags = durabilidad == DURABILIDAD_SYNC ? MS_SYNC : MS_ASYNC;
+            if (msync(map + primera * pagina, longitud, flags) == -1) {
+                perror("msync");
+                resultado = -1;
+                break;
+            }
+        }
+    }
+    double fin_msync = ahora();
+    free(sucias);
+
+    printf("Parches aplicados: %zu (%zu bytes) en %.6f s\n", n_parches, bytes, fin_aplicar - inicio);
+    printf("Páginas sucias: %zu de %zu, en %zu rangos; msync: %.6f s\n",
+           paginas_sucias, n_paginas, rangos, fin_msync - fin_aplicar);
+    return resultado;
+}
+
+// La demostración original: alterna el primer carácter y lo sincroniza
+static int demostracion(char *map, size_t tamaño, const char *nombre) {
+    // Imprimimos el contenido original del archivo desde la proyección
+    printf("\nContenido original:\n");
+    for (size_t i = 0; i < tamaño; i++) {
+        putchar(map[i]);
+    }
+    putchar('\n');
+
+    // Modificamos un carácter de la proyección
+    // Por ejemplo, cambiamos el primer carácter si existe
+    printf("\nModificando el primer carácter del archivo en la proyección...\n");
+    char original = map[0];
+    map[0] = (original == 'X') ? 'Y' : 'X';  // Alterna entre 'X' y 'Y' para verlo fácil
+
+    // Forzamos a que los cambios se sincronicen con el archivo
+    if (msync(map, tamaño, MS_SYNC) == -1) {
+        perror("msync");
+        return -1;
+    }
+
+    // Mostramos el contenido modificado desde la proyección
+    printf("\nContenido después de la modificación en memoria:\n");
+    for (size_t i = 0; i < tamaño; i++) {
+        putchar(map[i]);
+    }
+    putchar('\n');
+
+    printf("\nModificación realizada. Abre el archivo con 'cat %s' para comprobar.\n", nombre);
+    return 0;
+}
+
+static void uso(const char *programa) {
+    fprintf(stderr, "Formato invalido. Uso: %s [-p parches|- [-d none|async|sync]] <Nombre_Archivo>\n", programa);
+}
 
 int main(int argc, char *argv[]) {
+    const char *archivo_parches = NULL;     // NULL: demostración original
+    int durabilidad = DURABILIDAD_SYNC;
+    int durabilidad_pedida = 0;
 
-    if (argc < 2) {
-        fprintf(stderr, "Formato invalido. Uso: %s <Nombre_Archivo>\n", argv[0]);
+    int opcion;
+    while ((opcion = getopt(argc, argv, "p:d:")) != -1) {
+        switch (opcion) {
+        case 'p':
+            archivo_parches = optarg;
+            break;
+        case 'd':
+            durabilidad_pedida = 1;
+            if (strcmp(optarg, "none") == 0) {
+                durabilidad = DURABILIDAD_NONE;
+            } else if (strcmp(optarg, "async") == 0) {
+                durabilidad = DURABILIDAD_ASYNC;
+            } else if (strcmp(optarg, "sync") == 0) {
+                durabilidad = DURABILIDAD_SYNC;
+            } else {
+                uso(argv[0]);
+                return 1;
+            }
+            break;
+        default:
+            uso(argv[0]);
+            return 1;
+        }
+    }
+
+    // la durabilidad solo se aplica a los parches: la demostración usa MS_SYNC
+    if (optind != argc - 1 || (durabilidad_pedida && archivo_parches == NULL)) {
+        uso(argv[0]);
         return 1;
     }
+    const char *nombre = argv[optind];
 
     // Abrimos el archivo con lectura y ESCRITURA
-    int archivo = open(argv[1], O_RDWR);
+    int archivo = open(nombre, O_RDWR);
     if (archivo == -1) {
         perror("open");
         return 1;
@@ -32,13 +295,25 @@ int main(int argc, char *argv[]) {
         close(archivo);
         return 1;
     }
+    size_t tamaño = (size_t) st.st_size;
 
     printf("Tamaño del archivo: %ld bytes\n", st.st_size);
 
+    // Con parches, los leemos y validamos antes de proyectar nada
+    struct parche *parches = NULL;
+    size_t n_parches = 0;
+    if (archivo_parches != NULL) {
+        parches = leer_parches(archivo_parches, tamaño, &n_parches);
+        if (parches == NULL) {
+            close(archivo);
+            return 1;
+        }
+    }
+
     // Proyectamos el archivo en memoria con lectura y escritura, y área compartida
     char *map = mmap(
         NULL,               // Dirección elegida por el kernel
-        st.st_size,         // Tamaño a mapear
+        tamaño,             // Tamaño a mapear
         PROT_READ | PROT_WRITE, // Permisos: lectura y escritura
         MAP_SHARED,         // Memoria compartida: cambios -> archivo
         archivo,            // Descriptor de archivo
@@ -48,46 +323,30 @@ int main(int argc, char *argv[]) {
     if (map == MAP_FAILED) {
         perror("mmap");
         close(archivo);
+        for (size_t i = 0; i < n_parches; i++)
+            free(parches[i].bytes);
+        free(parches);
         return 1;
     }
 
     // Ya no necesitamos el descriptor abierto para trabajar con el mapping
     close(archivo);
 
-    // Imprimimos el contenido original del archivo desde la proyección
-    printf("\nContenido original:\n");
-    for (size_t i = 0; i < (size_t)st.st_size; i++) {
-        putchar(map[i]);
+    int resultado;
+    if (archivo_parches != NULL) {
+        resultado = aplicar_parches(map, tamaño, parches, n_parches, durabilidad);
+        for (size_t i = 0; i < n_parches; i++)
+            free(parches[i].bytes);
+        free(parches);
+    } else {
+        resultado = demostracion(map, tamaño, nombre);
     }
-    putchar('\n');
-
-    // Modificamos un carácter de la proyección
-    // Por ejemplo, cambiamos el primer carácter si existe
-    printf("\nModificando el primer carácter del archivo en la proyección...\n");
-    char original = map[0];
-    map[0] = (original == 'X') ? 'Y' : 'X';  // Alterna entre 'X' y 'Y' para verlo fácil
-
-    // Forzamos a que los cambios se sincronicen con el archivo
-    if (msync(map, st.st_size, MS_SYNC) == -1) {
-        perror("msync");
-        munmap(map, st.st_size);
-        return 1;
-    }
-
-    // Mostramos el contenido modificado desde la proyección
-    printf("\nContenido después de la modificación en memoria:\n");
-    for (size_t i = 0; i < (size_t)st.st_size; i++) {
-        putchar(map[i]);
-    }
-    putchar('\n');
 
     // Cerramos (desmapeamos) la proyección
-    if (munmap(map, st.st_size) == -1) {
+    if (munmap(map, tamaño) == -1) {
         perror("munmap");
         return 1;
     }
 
-    printf("\nModificación realizada. Abre el archivo con 'cat %s' para comprobar.\n", argv[1]);
-
-    return 0;
+    return resultado == 0 ? 0 : 1;
 }
@@ -3,18 +3,173 @@
 #include <sys/stat.h>
 #include <fcntl.h>      // open
 #include <sys/mman.h>   // mmap
-#include <unistd.h>     // close, getpid
+#include <unistd.h>     // close, getpid, getopt
+#include <string.h>
+#include <time.h>       // clock_gettime
+
+// Con -a el programa no se para a esperar a nadie: en cada etapa de la vida
+// de la proyección toma una instantánea y escribe una línea CSV con la
+// duración de la etapa, los campos de /proc/self/smaps de la proyección del
+// archivo y cuántas de sus páginas están en memoria según mincore:
+//   etapa,ns_etapa,ns_total,rss_kib,pss_kib,shared_dirty_kib,private_dirty_kib,anon_huge_kib,paginas_residentes,paginas
+// Sin proyección (antes del mmap y después del munmap) esos campos van vacíos.
+// Con -w se escribe un byte en cada página en lugar de solo en la primera.
+
+struct instantanea {
+    long rss, pss, shared_dirty, private_dirty, anon_huge;   // KiB
+};
+
+static long long ahora_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long long) t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+// Busca en /proc/self/smaps la entrada que empieza en 'inicio' y lee sus campos
+static int leer_smaps(const void *inicio, struct instantanea *ins) {
+    FILE *f = fopen("/proc/self/smaps", "r");
+    if (f == NULL) {
+        perror("fopen smaps");
+        return -1;
+    }
+    memset(ins, 0, sizeof(*ins));
+
+    char linea[512];
+    int dentro = 0, encontrada = 0;
+    while (fgets(linea, sizeof(linea), f) != NULL) {
+        unsigned long desde, hasta;
+        // las cabeceras de cada proyección son "desde-hasta permisos ..."
+        if (sscanf(linea, "%lx-%lx ", &desde, &hasta) == 2) {
+            if (dentro)
+                break;
+            dentro = desde == (unsigned long) inicio;
+            encontrada |= dentro;
+            continue;
+        }
+        if (!dentro)
+            continue;
+        sscanf(linea, "Rss: %ld", &ins->rss);
+        sscanf(linea, "Pss: %ld", &ins->pss);
+        sscanf(linea, "Shared_Dirty: %ld", &ins->shared_dirty);
+        sscanf(linea, "Private_Dirty: %ld", &ins->private_dirty);
+        sscanf(linea, "AnonHugePages: %ld", &ins->anon_huge);
+    }
+    fclose(f);
+    return encontrada ? 0 : -1;
+}
+
+// Escribe la línea CSV de una etapa; 'map' es NULL si no hay proyección
+static void instantanea(const char *etapa, long long inicio_etapa, long long origen, char *map, size_t tamaño) {
+    long long fin = ahora_ns();
+    printf("%s,%lld,%lld", etapa, fin - inicio_etapa, fin - origen);
+
+    struct instantanea ins;
+    if (map == NULL || leer_smaps(map, &ins) < 0) {
+        printf(",,,,,,,\n");
+        return;
+    }
+
+    size_t pagina = (size_t) sysconf(_SC_PAGESIZE);
+    size_t paginas = (tamaño + pagina - 1) / pagina;
+    size_t residentes = 0;
+    unsigned char *vector = malloc(paginas);
+    if (vector != NULL && mincore(map, tamaño, vector) == 0) {
+        for (size_t i = 0; i < paginas; i++)
+            residentes += vector[i] & 1;
+    }
+    free(vector);
+
+    printf(",%ld,%ld,%ld,%ld,%ld,%zu,%zu\n", ins.rss, ins.pss, ins.shared_dirty, ins.private_dirty,
+           ins.anon_huge, residentes, paginas);
+}
+
+// Recorre el ciclo de vida de la proyección sin pausas, midiendo cada etapa
+static int inspeccionar(const char *nombre, int escribir_todas) {
+    printf("etapa,ns_etapa,ns_total,rss_kib,pss_kib,shared_dirty_kib,private_dirty_kib,anon_huge_kib,"
+           "paginas_residentes,paginas\n");
+    long long origen = ahora_ns();
+    instantanea("antes_mmap", origen, origen, NULL, 0);
+
+    int archivo = open(nombre, O_RDWR);
+    if (archivo == -1) {
+        perror("open");
+        return 1;
+    }
+    struct stat st;
+    if (fstat(archivo, &st) == -1 || st.st_size == 0) {
+        fprintf(stderr, "No se puede mapear el archivo (fstat falló o está vacío).\n");
+        close(archivo);
+        return 1;
+    }
+    size_t tamaño = (size_t) st.st_size;
+    size_t pagina = (size_t) sysconf(_SC_PAGESIZE);
+
+    long long inicio = ahora_ns();
+    char *map = mmap(NULL, tamaño, PROT_READ | PROT_WRITE, MAP_SHARED, archivo, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        close(archivo);
+        return 1;
+    }
+    close(archivo);
+    instantanea("despues_mmap", inicio, origen, map, tamaño);
+
+    // primer acceso: una lectura por página
+    inicio = ahora_ns();
+    volatile char suma = 0;
+    for (size_t i = 0; i < tamaño; i += pagina)
+        suma += map[i];
+    (void) suma;
+    instantanea("primer_acceso", inicio, origen, map, tamaño);
+
+    inicio = ahora_ns();
+    for (size_t i = 0; i < tamaño; i += escribir_todas ? pagina : tamaño)
+        map[i] = (map[i] == 'X') ? 'Y' : 'X';
+    instantanea("despues_escritura", inicio, origen, map, tamaño);
+
+    inicio = ahora_ns();
+    instantanea("antes_msync", inicio, origen, map, tamaño);
+
+    inicio = ahora_ns();
+    if (msync(map, tamaño, MS_SYNC) == -1) {
+        perror("msync");
+        munmap(map, tamaño);
+        return 1;
+    }
+    instantanea("despues_msync", inicio, origen, map, tamaño);
+
+    inicio = ahora_ns();
+    if (munmap(map, tamaño) == -1) {
+        perror("munmap");
+        return 1;
+    }
+    instantanea("despues_munmap", inicio, origen, NULL, 0);
+    return 0;
+}
 
 int main(int argc, char *argv[]) {
 
-    if (argc < 2) {
-        fprintf(stderr, "Formato invalido. Uso: %s <Nombre_Archivo>\n", argv[0]);
+    int automatico = 0, escribir_todas = 0;
+    int opcion;
+    while ((opcion = getopt(argc, argv, "aw")) != -1) {
+        switch (opcion) {
+        case 'a': automatico = 1; break;
+        case 'w': escribir_todas = 1; break;
+        default: optind = argc + 1; break;
+        }
+    }
+
+    if (optind != argc - 1) {
+        fprintf(stderr, "Formato invalido. Uso: %s [-a [-w]] <Nombre_Archivo>\n", argv[0]);
         return 1;
     }
 
+    if (automatico)
+        return inspeccionar(argv[optind], escribir_todas);
+
     // Mostramos el PID para poder ver /proc/PID/maps y usar pmap
     printf("PID del proceso: %d\n", getpid());
-    printf("Archivo a mapear: %s\n", argv[1]);
+    printf("Archivo a mapear: %s\n", argv[optind]);
 
     printf("\n>>> ANTES del mmap\n");
     printf("Abra otra terminal y ejecute:\n");
@@ -23,7 +178,7 @@ int main(int argc, char *argv[]) {
     getchar();
 
     // Abrimos el archivo con lectura y ESCRITURA
-    int archivo = open(argv[1], O_RDWR);
+    int archivo = open(argv[optind], O_RDWR);
     if (archivo == -1) {
         perror("open");
         return 1;
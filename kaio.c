@@ -1,252 +1,2862 @@
+#define _GNU_SOURCE     // fallocate
 #include <stdio.h>
 #include <stdlib.h>
-#include <ctype.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <string.h>
-#include <unistd.h>     // close, usleep, fork
+#include <unistd.h>     // close, fork, syscall, getopt
 #include <sys/wait.h>   // wait
+#include <limits.h>     // INT_MAX
+#include <linux/futex.h>    // FUTEX_WAIT, FUTEX_WAKE
+#include <sys/syscall.h>    // SYS_futex
+#include <signal.h>     // SIGPIPE
+#include <errno.h>
+#include <time.h>       // clock_gettime
+#include <getopt.h>     // getopt_long
+#include <sys/uio.h>    // struct iovec
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <inttypes.h>     // PRIu64
+#include <sys/resource.h>   // getrusage
+#include <pthread.h>
+#include <dirent.h>     // opendir (--batch con directorio)
 
-int main (int argc, char *argv[]) {
-    if (argc != 3) {
-        fprintf(stderr, "Uso correcto: %s <archivo_entrada> <archivo_salida>\n", argv[0]);
+#include "libkaio.h"
+#include <linux/perf_event.h>
+
+#define MAX_TRABAJADORES 256
+
+// Bloque de control compartido entre padre e hijo (memoria anónima, no el archivo)
+struct control {
+    int progreso;   // palabra futex: trozos que el padre ya ha terminado
+};
+
+// Publica un nuevo estado y despierta a quien lo esté esperando.
+// La escritura con RELEASE garantiza que todo lo escrito antes en la salida
+// compartida es visible para el proceso que observe el nuevo estado.
+static void publicar_estado(int *palabra, int valor) {
+    __atomic_store_n(palabra, valor, __ATOMIC_RELEASE);
+    syscall(SYS_futex, palabra, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// Bloquea al proceso hasta que el estado llegue al menos a 'minimo'.
+// FUTEX_WAIT solo duerme si la palabra sigue valiendo 'actual', así que no se
+// pierde ningún aviso entre la lectura y la espera.
+static void esperar_estado(int *palabra, int minimo) {
+    int actual;
+    while ((actual = __atomic_load_n(palabra, __ATOMIC_ACQUIRE)) < minimo)
+        syscall(SYS_futex, palabra, FUTEX_WAIT, actual, NULL, NULL, 0);
+}
+
+// --- ESTADÍSTICAS POR FASE (--stats) ---
+// Cada proceso acumula, por fase, el tiempo, los fallos de página (getrusage)
+// y, si el kernel los ofrece, contadores hardware de perf_event_open. La tabla
+// vive en memoria compartida y el proceso principal la escribe al final en CSV.
+// El proceso 0 es el principal y sus fases son pasos completos: su "fork" y su
+// "espera" (a los hijos) están contenidos en su "medicion" o "transformacion".
+// Los hijos son 1..N (en el modo padre/hijo, el hijo es el 1).
+
+#define FASE_MMAP_ENTRADA   0
+#define FASE_MEDICION       1   // pasada de tamaño y cuenta de asteriscos
+#define FASE_FOOTER         2
+#define FASE_FTRUNCATE      3   // crear el archivo de salida con su tamaño final
+#define FASE_MMAP_SALIDA    4
+#define FASE_FORK           5
+#define FASE_TRANSFORMACION 6
+#define FASE_ESPERA         7   // esperas de traspaso (futex) o a los hijos
+#define FASE_MEMCPY         8   // copia del footer
+#define FASE_DURABILIDAD    9   // --durability
+#define N_FASES             10
+
+#define N_CONTADORES 4
+
+static const char *const nombres_fases[N_FASES] = {
+    "mmap_entrada", "medicion", "footer", "ftruncate", "mmap_salida",
+    "fork", "transformacion", "espera", "memcpy", "durabilidad"
+};
+
+struct marca {
+    uint64_t ns;
+    long fallos_menores;
+    long fallos_mayores;
+    uint64_t contador[N_CONTADORES];   // ciclos, instrucciones, fallos LLC, fallos dTLB
+};
+
+struct medida_fase {
+    uint64_t veces;
+    unsigned disponibles;   // bit i: el contador i se pudo medir
+    struct marca total;     // suma de las diferencias entre fin e inicio
+};
+
+static struct medida_fase (*estadisticas)[N_FASES];    // NULL: --stats desactivado
+// por hilo: con --hilos cada trabajador es un hilo con su fila y sus contadores
+static __thread int proceso_actual;
+static __thread int fd_contadores[N_CONTADORES] = { -1, -1, -1, -1 };
+
+static uint64_t ahora_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000u + (uint64_t) t.tv_nsec;
+}
+
+// Abre los contadores hardware del proceso actual. Los que el kernel no
+// ofrezca (máquinas virtuales, perf_event_paranoid) se quedan en -1.
+static void abrir_contadores(void) {
+    static const uint64_t eventos[N_CONTADORES][2] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                              PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                              PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+    };
+    for (int i = 0; i < N_CONTADORES; i++) {
+        struct perf_event_attr atributos;
+        memset(&atributos, 0, sizeof(atributos));
+        atributos.size = sizeof(atributos);
+        atributos.type = (uint32_t) eventos[i][0];
+        atributos.config = eventos[i][1];
+        atributos.exclude_hv = 1;
+        // sin permiso para medir el kernel, contamos solo el espacio de usuario
+        for (int solo_usuario = 0; solo_usuario < 2 && fd_contadores[i] < 0; solo_usuario++) {
+            atributos.exclude_kernel = solo_usuario;
+            fd_contadores[i] = (int) syscall(SYS_perf_event_open, &atributos, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        }
+    }
+}
+
+static int activar_estadisticas(void) {
+    estadisticas = mmap(NULL, (MAX_TRABAJADORES + 1) * sizeof(*estadisticas), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (estadisticas == MAP_FAILED) {
+        estadisticas = NULL;
+        perror("mmap estadisticas");
+        return -1;
+    }
+    abrir_contadores();
+    return 0;
+}
+
+// Llamada por cada trabajador nada más nacer: los contadores heredados de un
+// fork miden al padre (un hilo nuevo empieza ya sin contadores)
+static void iniciar_estadisticas_hijo(int proceso) {
+    if (estadisticas == NULL)
+        return;
+    proceso_actual = proceso;
+    for (int i = 0; i < N_CONTADORES; i++) {
+        if (fd_contadores[i] >= 0)
+            close(fd_contadores[i]);
+        fd_contadores[i] = -1;
+    }
+    abrir_contadores();
+}
+
+static void tomar_marca(struct marca *m) {
+    struct rusage uso;
+    getrusage(RUSAGE_THREAD, &uso);    // igual que RUSAGE_SELF en un proceso de un solo hilo
+    m->fallos_menores = uso.ru_minflt;
+    m->fallos_mayores = uso.ru_majflt;
+    for (int i = 0; i < N_CONTADORES; i++)
+        if (fd_contadores[i] < 0 || read(fd_contadores[i], &m->contador[i], sizeof(uint64_t)) != sizeof(uint64_t))
+            m->contador[i] = 0;
+    m->ns = ahora_ns();
+}
+
+static void empezar_fase(struct marca *inicio) {
+    if (estadisticas != NULL)
+        tomar_marca(inicio);
+}
+
+static void terminar_fase(int fase, const struct marca *inicio) {
+    if (estadisticas == NULL)
+        return;
+    struct marca fin;
+    tomar_marca(&fin);
+
+    // cada proceso escribe solo su fila; el padre la lee después de wait()
+    struct medida_fase *f = &estadisticas[proceso_actual][fase];
+    f->veces++;
+    f->total.ns += fin.ns - inicio->ns;
+    f->total.fallos_menores += fin.fallos_menores - inicio->fallos_menores;
+    f->total.fallos_mayores += fin.fallos_mayores - inicio->fallos_mayores;
+    for (int i = 0; i < N_CONTADORES; i++) {
+        if (fd_contadores[i] >= 0) {
+            f->disponibles |= 1u << i;
+            f->total.contador[i] += fin.contador[i] - inicio->contador[i];
+        }
+    }
+}
+
+// CSV: proceso,fase,veces,ns,fallos_menores,fallos_mayores,ciclos,instrucciones,fallos_llc,fallos_dtlb
+// Los contadores que no se pudieron medir quedan vacíos.
+static int escribir_estadisticas(const char *archivo) {
+    FILE *f = archivo != NULL ? fopen(archivo, "w") : stderr;
+    if (f == NULL) {
+        perror("fopen estadisticas");
+        return -1;
+    }
+    fprintf(f, "proceso,fase,veces,ns,fallos_menores,fallos_mayores,ciclos,instrucciones,fallos_llc,fallos_dtlb\n");
+    for (int p = 0; p <= MAX_TRABAJADORES; p++) {
+        for (int fase = 0; fase < N_FASES; fase++) {
+            const struct medida_fase *m = &estadisticas[p][fase];
+            if (m->veces == 0)
+                continue;
+            fprintf(f, "%d,%s,%" PRIu64 ",%" PRIu64 ",%ld,%ld", p, nombres_fases[fase], m->veces,
+                    m->total.ns, m->total.fallos_menores, m->total.fallos_mayores);
+            for (int i = 0; i < N_CONTADORES; i++) {
+                if (m->disponibles & (1u << i))
+                    fprintf(f, ",%" PRIu64, m->total.contador[i]);
+                else
+                    fprintf(f, ",");
+            }
+            fprintf(f, "\n");
+        }
+    }
+    if (archivo == NULL)
+        return fflush(f) == 0 ? 0 : -1;
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+// --- TRABAJADORES: PROCESOS O HILOS (--hilos) ---
+// Por defecto cada trabajador es un proceso hijo (fork) que comparte con el
+// padre solo la memoria MAP_SHARED. Con --hilos cada trabajador es un hilo del
+// mismo proceso: no hay que copiar tablas de páginas ni hay fallos de copia en
+// escritura. Toda la coordinación (futex, CAS sobre las colas) es la misma,
+// porque la memoria MAP_SHARED también se comparte entre hilos.
+
+static int usar_hilos = 0;
+
+struct trabajador {
+    int id;
+    void (*funcion)(int id, void *arg);
+    void *arg;
+    pid_t pid;
+    pthread_t hilo;
+};
+
+struct grupo {
+    int lanzados;
+    struct trabajador trabajadores[MAX_TRABAJADORES];
+};
+
+static void *arrancar_hilo(void *arg) {
+    struct trabajador *t = arg;
+    iniciar_estadisticas_hijo(t->id + 1);
+    t->funcion(t->id, t->arg);
+    return NULL;
+}
+
+// Arranca 'n' trabajadores que ejecutan funcion(id, arg) sin esperarlos.
+// Si falla alguno devuelve -1; los ya lanzados hay que esperarlos igualmente.
+static int iniciar_trabajadores(struct grupo *g, int n, void (*funcion)(int id, void *arg), void *arg) {
+    struct marca marca;
+    int resultado = 0;
+
+    g->lanzados = 0;
+    empezar_fase(&marca);
+    for (int id = 0; id < n; id++) {
+        struct trabajador *t = &g->trabajadores[id];
+        t->id = id;
+        t->funcion = funcion;
+        t->arg = arg;
+        if (usar_hilos) {
+            int error = pthread_create(&t->hilo, NULL, arrancar_hilo, t);
+            if (error != 0) {
+                fprintf(stderr, "pthread_create: %s\n", strerror(error));
+                resultado = -1;
+                break;
+            }
+        } else {
+            t->pid = fork();
+            if (t->pid < 0) {
+                perror("fork");
+                resultado = -1;
+                break;
+            } else if (t->pid == 0) {
+                iniciar_estadisticas_hijo(id + 1);
+                funcion(id, arg);
+                // sin atexit ni vaciar los buffers de stdio heredados del padre
+                _exit(0);
+            }
+        }
+        g->lanzados++;
+    }
+    terminar_fase(FASE_FORK, &marca);
+    return resultado;
+}
+
+// Espera a todos los trabajadores lanzados; -1 si alguno terminó con error
+static int esperar_trabajadores(struct grupo *g) {
+    struct marca marca;
+    int resultado = 0;
+
+    empezar_fase(&marca);
+    for (int i = 0; i < g->lanzados; i++) {
+        struct trabajador *t = &g->trabajadores[i];
+        if (usar_hilos) {
+            if (pthread_join(t->hilo, NULL) != 0)
+                resultado = -1;
+        } else {
+            int estado;
+            if (waitpid(t->pid, &estado, 0) < 0 || !WIFEXITED(estado) || WEXITSTATUS(estado) != 0)
+                resultado = -1;
+        }
+    }
+    terminar_fase(FASE_ESPERA, &marca);
+    return resultado;
+}
+
+// Lanza 'n' trabajadores que ejecutan funcion(id, arg) y espera a todos.
+// Devuelve -1 si no se pudo crear alguno o alguno terminó con error.
+static int lanzar_trabajadores(int n, void (*funcion)(int id, void *arg), void *arg) {
+    struct grupo grupo;
+    int resultado = iniciar_trabajadores(&grupo, n, funcion, arg);
+    if (esperar_trabajadores(&grupo) < 0)
+        resultado = -1;
+    return resultado;
+}
+
+// --- MODO PARALELO (-j N) ---
+// La entrada se corta en muchos trozos pequeños (tareas). Primero se mide cada
+// trozo, una suma prefija exclusiva da el desplazamiento de cada trozo en la
+// salida y después cada trozo se transforma directamente en ese desplazamiento.
+// En las dos fases los trozos se reparten entre N trabajadores en rangos
+// contiguos de igual peso (bytes de entrada al medir, bytes de salida al
+// transformar) y el trabajador que vacía su cola roba trozos del final de la
+// cola de otro. Así las zonas llenas de dígitos, que ocupan hasta 9 veces más,
+// no dejan a unos trabajadores esperando a otros.
+
+#define TAM_TROZO   (256 * 1024)    // entrada por trozo (máximo)
+
+// Resultado de la medición de un trozo (tabla en memoria compartida)
+struct trozo {
+    size_t tamaño;          // tamaño transformado del trozo
+    uint64_t asteriscos;    // '*' que tendrá la salida del trozo
+    size_t desplazamiento;  // offset del trozo en la salida (suma prefija exclusiva)
+};
+
+struct trozos {
+    const char *map_entrada;
+    size_t tamaño_entrada;
+    char *map_salida;
+    size_t tam_trozo;
+    size_t n_trozos;
+    int n_trabajadores;
+    struct trozo *tabla;    // memoria compartida: una entrada por trozo
+    uint64_t *colas;        // memoria compartida: cola de trozos de cada trabajador
+    size_t tamaño_compartido;
+    void (*tarea)(struct trozos *t, size_t k);
+    int fase;               // FASE_MEDICION o FASE_TRANSFORMACION (para --stats)
+};
+
+// Cada cola es un rango [cabeza, cola) de índices de trozo empaquetado en 64
+// bits, para que dueño y ladrones lo modifiquen con un único CAS. El dueño
+// avanza la cabeza (recorre la entrada en orden) y los ladrones retroceden la
+// cola. Los trozos solo salen de las colas, nunca entran, así que un rango ya
+// vaciado no puede volver a aparecer con el mismo valor (no hay ABA).
+static uint64_t empaquetar_cola(uint32_t cabeza, uint32_t cola) {
+    return (uint64_t) cola << 32 | cabeza;
+}
+
+// Saca un trozo de la cola (por delante si 'robar' es 0, por detrás si no).
+// Devuelve 0 si la cola está vacía.
+static int sacar_trozo(uint64_t *cola_trabajo, int robar, size_t *k) {
+    uint64_t actual = __atomic_load_n(cola_trabajo, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint32_t cabeza = (uint32_t) actual;
+        uint32_t cola = (uint32_t) (actual >> 32);
+        if (cabeza >= cola)
+            return 0;
+        uint64_t nuevo = robar ? empaquetar_cola(cabeza, cola - 1) : empaquetar_cola(cabeza + 1, cola);
+        if (__atomic_compare_exchange_n(cola_trabajo, &actual, nuevo, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *k = robar ? cola - 1 : cabeza;
+            return 1;
+        }
+    }
+}
+
+static void trabajar(int id, void *arg) {
+    struct trozos *t = arg;
+    size_t k;
+    struct marca marca;
+
+    empezar_fase(&marca);
+
+    // primero la cola propia, en orden
+    while (sacar_trozo(&t->colas[id], 0, &k))
+        t->tarea(t, k);
+
+    // después robamos a los demás hasta que no quede nada en ninguna cola
+    int robado;
+    do {
+        robado = 0;
+        for (int i = 1; i < t->n_trabajadores; i++) {
+            int victima = (id + i) % t->n_trabajadores;
+            while (sacar_trozo(&t->colas[victima], 1, &k)) {
+                t->tarea(t, k);
+                robado = 1;
+            }
+        }
+    } while (robado);
+
+    terminar_fase(t->fase, &marca);
+}
+
+// Reparte los trozos en rangos contiguos de peso parecido: por bytes de
+// entrada (todos iguales) o, si 'por_salida', por bytes de salida ya medidos
+static void repartir_trozos(struct trozos *t, int por_salida, size_t tamaño_intermedio) {
+    size_t k = 0;
+    for (int w = 0; w < t->n_trabajadores; w++) {
+        size_t inicio = k;
+        if (w == t->n_trabajadores - 1) {
+            k = t->n_trozos;
+        } else if (por_salida) {
+            size_t limite = tamaño_intermedio / t->n_trabajadores * (w + 1);
+            while (k < t->n_trozos && t->tabla[k].desplazamiento < limite)
+                k++;
+        } else {
+            k = t->n_trozos * (w + 1) / t->n_trabajadores;
+        }
+        t->colas[w] = empaquetar_cola((uint32_t) inicio, (uint32_t) k);
+    }
+}
+
+static void medir_trozo(struct trozos *t, size_t k) {
+    size_t inicio = k * t->tam_trozo;
+    size_t fin = inicio + t->tam_trozo < t->tamaño_entrada ? inicio + t->tam_trozo : t->tamaño_entrada;
+    t->tabla[k].asteriscos = 0;
+    t->tabla[k].tamaño = kaio_medir(t->map_entrada + inicio, fin - inicio, &t->tabla[k].asteriscos);
+}
+
+static void transformar_trozo(struct trozos *t, size_t k) {
+    size_t inicio = k * t->tam_trozo;
+    size_t fin = inicio + t->tam_trozo < t->tamaño_entrada ? inicio + t->tam_trozo : t->tamaño_entrada;
+    kaio_transformar(t->map_entrada + inicio, fin - inicio, t->map_salida + t->tabla[k].desplazamiento);
+}
+
+// Prepara los trozos y la memoria compartida del modo paralelo.
+// Con entradas pequeñas los trozos se achican para que haya trabajo que robar.
+static int preparar_trozos(struct trozos *t, const char *map_entrada, size_t tamaño_entrada, int n_trabajadores) {
+    t->map_entrada = map_entrada;
+    t->tamaño_entrada = tamaño_entrada;
+    t->n_trabajadores = n_trabajadores;
+    t->tam_trozo = TAM_TROZO;
+    while (t->tam_trozo > 4096 && t->tam_trozo * 16 * (size_t) n_trabajadores > tamaño_entrada)
+        t->tam_trozo /= 2;
+    t->n_trozos = (tamaño_entrada + t->tam_trozo - 1) / t->tam_trozo;
+    if (t->n_trozos > UINT32_MAX) {
+        fprintf(stderr, "Entrada demasiado grande para el modo paralelo.\n");
+        return -1;
+    }
+
+    t->tamaño_compartido = MAX_TRABAJADORES * sizeof(uint64_t) + (t->n_trozos + 1) * sizeof(struct trozo);
+    t->colas = mmap(NULL, t->tamaño_compartido, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (t->colas == MAP_FAILED) {
+        perror("mmap tablas");
+        return -1;
+    }
+    t->tabla = (struct trozo *) (t->colas + MAX_TRABAJADORES);
+    return 0;
+}
+
+static void liberar_trozos(struct trozos *t) {
+    munmap(t->colas, t->tamaño_compartido);
+}
+
+// Fase 1 del modo paralelo: medición por trozos y suma prefija exclusiva.
+// Los asteriscos de cada trozo se reducen en '*asteriscos'.
+// Devuelve el tamaño intermedio total o (size_t)-1 si hubo error.
+static size_t medir_paralelo(struct trozos *t, uint64_t *asteriscos) {
+    t->tarea = medir_trozo;
+    t->fase = FASE_MEDICION;
+    repartir_trozos(t, 0, 0);
+    if (lanzar_trabajadores(t->n_trabajadores, trabajar, t) < 0)
+        return (size_t)-1;
+
+    size_t acumulado = 0;
+    for (size_t k = 0; k < t->n_trozos; k++) {
+        t->tabla[k].desplazamiento = acumulado;
+        acumulado += t->tabla[k].tamaño;
+        *asteriscos += t->tabla[k].asteriscos;
+    }
+    return acumulado;
+}
+
+// Fase 2 del modo paralelo: cada trozo se escribe en su desplazamiento
+static int transformar_paralelo(struct trozos *t, char *map_salida, size_t tamaño_intermedio) {
+    t->map_salida = map_salida;
+    t->tarea = transformar_trozo;
+    t->fase = FASE_TRANSFORMACION;
+    repartir_trozos(t, 1, tamaño_intermedio);
+    return lanzar_trabajadores(t->n_trabajadores, trabajar, t);
+}
+
+// --- OPCIONES DE MEMORIA (--huge, --prefault) ---
+// --huge=thp pide páginas enormes transparentes (MADV_HUGEPAGE) para los
+// buffers anónimos y las proyecciones de los archivos; --huge=hugetlb reserva
+// los buffers anónimos con MAP_HUGETLB y, si no hay páginas enormes
+// reservadas en el sistema, vuelve a páginas normales con MADV_HUGEPAGE.
+// --prefault rellena la entrada y los buffers anónimos al proyectarlos
+// (MAP_POPULATE, que ya incluye la lectura anticipada de WILLNEED) con lectura
+// secuencial, y reserva el espacio de la salida con fallocate en lugar de
+// dejarla dispersa.
+// El efecto en fallos de página y fallos de dTLB se ve con --stats.
+
+#define PAGINAS_NORMALES    0
+#define PAGINAS_THP         1
+#define PAGINAS_HUGETLB     2
+
+#define TAM_PAGINA_ENORME   (2UL << 20)
+
+static int paginas_grandes = PAGINAS_NORMALES;
+static int prefaltar = 0;
+
+static size_t tamaño_anonimo(size_t tamaño) {
+    if (paginas_grandes != PAGINAS_HUGETLB)
+        return tamaño;
+    return (tamaño + TAM_PAGINA_ENORME - 1) & ~(TAM_PAGINA_ENORME - 1);
+}
+
+// Reserva un buffer anónimo ('flags': MAP_SHARED o MAP_PRIVATE) con las
+// páginas pedidas. Se libera con liberar_anonima y el mismo tamaño.
+static void *reservar_anonima(size_t tamaño, int flags) {
+    flags |= MAP_ANONYMOUS | (prefaltar ? MAP_POPULATE : 0);
+    if (paginas_grandes == PAGINAS_HUGETLB) {
+        void *p = mmap(NULL, tamaño_anonimo(tamaño), PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+            return p;
+        fprintf(stderr, "MAP_HUGETLB no disponible (%s), se usan páginas normales.\n", strerror(errno));
+        paginas_grandes = PAGINAS_THP;
+    }
+    void *p = mmap(NULL, tamaño, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (p != MAP_FAILED && paginas_grandes == PAGINAS_THP)
+        madvise(p, tamaño, MADV_HUGEPAGE);
+    return p;
+}
+
+static void liberar_anonima(void *p, size_t tamaño) {
+    munmap(p, tamaño_anonimo(tamaño));
+}
+
+// Proyecta una parte de la entrada (o toda) para leerla de principio a fin
+static char *proyectar_entrada(int descriptor, size_t longitud, size_t offset) {
+    char *map = mmap(NULL, longitud, PROT_READ, MAP_PRIVATE | (prefaltar ? MAP_POPULATE : 0),
+                     descriptor, (off_t) offset);
+    if (map == MAP_FAILED)
+        return map;
+    if (prefaltar)
+        madvise(map, longitud, MADV_SEQUENTIAL);
+    if (paginas_grandes != PAGINAS_NORMALES)
+        madvise(map, longitud, MADV_HUGEPAGE);  // solo donde el sistema de archivos lo admita
+    return map;
+}
+
+// Sin MAP_POPULATE: en una proyección compartida el kernel la rellena de solo
+// lectura y cada primera escritura volvería a fallar (hay más fallos, no menos)
+static char *proyectar_salida(int descriptor, size_t longitud, size_t offset) {
+    char *map = mmap(NULL, longitud, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, (off_t) offset);
+    if (map != MAP_FAILED && paginas_grandes != PAGINAS_NORMALES)
+        madvise(map, longitud, MADV_HUGEPAGE);
+    return map;
+}
+
+// Crea (o vacía) el archivo de salida y le da su tamaño final una sola vez.
+// Devuelve el descriptor abierto o -1 si hubo error.
+static int crear_salida(const char *salidafile, size_t tamaño_final) {
+    int descriptor_salida = open(salidafile, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (descriptor_salida < 0) {
+        perror("open salida");
+        return -1;
+    }
+    // con --prefault los bloques quedan reservados; si el sistema de archivos
+    // no admite fallocate seguimos con un ftruncate normal
+    if (prefaltar && tamaño_final > 0) {
+        if (fallocate(descriptor_salida, 0, 0, (off_t) tamaño_final) == 0)
+            return descriptor_salida;
+        if (errno != EOPNOTSUPP) {
+            perror("fallocate salida");
+            close(descriptor_salida);
+            return -1;
+        }
+    }
+    if (ftruncate(descriptor_salida, tamaño_final) == -1) {
+        perror("ftruncate salida");
+        close(descriptor_salida);
+        return -1;
+    }
+    return descriptor_salida;
+}
+
+// --- DURABILIDAD (--durability) ---
+// Qué se espera antes de dar la salida por terminada. Se aplica una sola vez,
+// al final de cada modo y sobre el descriptor de la salida:
+//   none:  nada; el kernel escribe las páginas sucias cuando quiera
+//   async: pone en marcha la escritura sin esperarla. Es lo que pedía
+//          msync(MS_ASYNC), que en Linux ya no hace nada: sync_file_range
+//          sirve igual para las salidas proyectadas y para las escritas con write
+//   data:  un fdatasync: los datos y el tamaño del archivo
+//   full:  fsync del archivo y del directorio, para que la entrada de un
+//          archivo recién creado también sobreviva a un corte
+// Sin --durability cada modo hace lo que hacía antes (ver elegir_durabilidad)
+// y no se informa del tiempo.
+#define DURABILIDAD_NONE  0
+#define DURABILIDAD_ASYNC 1
+#define DURABILIDAD_DATA  2
+#define DURABILIDAD_FULL  3
+
+static int durabilidad = -1;  // -1: sin --durability
+static int durabilidad_pedida;
+static const char *const nombres_durabilidad[] = { "none", "async", "data", "full" };
+
+// Sin --durability: data donde antes había msync(MS_SYNC) o fsync (el modo
+// clásico, -j, -m, --io=uring e --incremental) y none en los que nunca
+// sincronizaron (lote, tubería, RLE, --io=directo)
+static void elegir_durabilidad(int sincronizaba) {
+    durabilidad_pedida = durabilidad >= 0;
+    if (!durabilidad_pedida)
+        durabilidad = sincronizaba ? DURABILIDAD_DATA : DURABILIDAD_NONE;
+}
+
+static int sincronizar_directorio(const char *salidafile) {
+    char directorio[PATH_MAX];
+    const char *barra = strrchr(salidafile, '/');
+    size_t longitud = barra == NULL ? 0 : barra == salidafile ? 1 : (size_t) (barra - salidafile);
+    if (longitud >= sizeof(directorio)) {
+        fprintf(stderr, "Nombre de salida demasiado largo.\n");
+        return -1;
+    }
+    if (longitud == 0) {
+        strcpy(directorio, ".");
+    } else {
+        memcpy(directorio, salidafile, longitud);
+        directorio[longitud] = '\0';
+    }
+
+    int descriptor = open(directorio, O_RDONLY | O_DIRECTORY);
+    if (descriptor < 0) {
+        perror("open directorio salida");
+        return -1;
+    }
+    int resultado = fsync(descriptor);
+    if (resultado == -1)
+        perror("fsync directorio salida");
+    close(descriptor);
+    return resultado;
+}
+
+// Aplica la política a la salida y suma a *ns lo que ha tardado
+static int sincronizar_salida(int descriptor, const char *salidafile, uint64_t *ns) {
+    uint64_t inicio = ahora_ns();
+    int resultado = 0;
+    switch (durabilidad) {
+    case DURABILIDAD_ASYNC:
+        if (sync_file_range(descriptor, 0, 0, SYNC_FILE_RANGE_WRITE) == -1) {
+            perror("sync_file_range salida");
+            resultado = -1;
+        }
+        break;
+    case DURABILIDAD_DATA:
+        if (fdatasync(descriptor) == -1) {
+            perror("fdatasync salida");
+            resultado = -1;
+        }
+        break;
+    case DURABILIDAD_FULL:
+        if (fsync(descriptor) == -1) {
+            perror("fsync salida");
+            resultado = -1;
+        } else {
+            resultado = sincronizar_directorio(salidafile);
+        }
+        break;
+    }
+    *ns += ahora_ns() - inicio;
+    return resultado;
+}
+
+static void informar_durabilidad(uint64_t ns) {
+    if (durabilidad_pedida)
+        printf("Durabilidad %s: %.6f s\n", nombres_durabilidad[durabilidad], (double) ns / 1e9);
+}
+
+// Lo mismo para un único archivo, informando del tiempo añadido
+static int aplicar_durabilidad(int descriptor, const char *salidafile) {
+    uint64_t ns = 0;
+    if (sincronizar_salida(descriptor, salidafile, &ns) < 0)
+        return -1;
+    informar_durabilidad(ns);
+    return 0;
+}
+
+// --- MODO POR VENTANAS (-m MiB) ---
+// Para entradas más grandes que la RAM: en lugar de proyectar la entrada y la
+// salida completas, se proyectan ventanas con offset que se van deslizando.
+// Cada ventana consumida se libera con MADV_DONTNEED antes de desproyectarla,
+// así la memoria residente no pasa nunca de 'memoria_maxima'.
+static int procesar_por_ventanas(int descriptor_entrada, size_t tamaño_entrada,
+                                 const char *salidafile, size_t memoria_maxima) {
+    size_t pagina = (size_t) sysconf(_SC_PAGESIZE);
+
+    // En el peor caso (todo '9') la salida de una ventana ocupa 9 veces la
+    // entrada, más una página por alinear el offset de la proyección de salida
+    if (memoria_maxima < 11 * pagina) {
+        fprintf(stderr, "La memoria máxima debe ser de al menos %zu bytes.\n", 11 * pagina);
+        return -1;
+    }
+    size_t ventana = (memoria_maxima - pagina) / 10 / pagina * pagina;
+    size_t n_ventanas = (tamaño_entrada + ventana - 1) / ventana;
+
+    // tamaño transformado de cada ventana, para no medir dos veces
+    size_t *tamaños_ventana = malloc((n_ventanas ? n_ventanas : 1) * sizeof(size_t));
+    if (tamaños_ventana == NULL) {
+        perror("malloc");
+        return -1;
+    }
+
+    // Fase 1: medir ventana a ventana
+    size_t tamaño_intermedio = 0;
+    uint64_t total_asteriscos = 0;
+    for (size_t v = 0; v < n_ventanas; v++) {
+        size_t offset = v * ventana;
+        size_t longitud = tamaño_entrada - offset < ventana ? tamaño_entrada - offset : ventana;
+        char *map_entrada = proyectar_entrada(descriptor_entrada, longitud, offset);
+        if (map_entrada == MAP_FAILED) {
+            perror("mmap ventana entrada");
+            free(tamaños_ventana);
+            return -1;
+        }
+        madvise(map_entrada, longitud, MADV_SEQUENTIAL);
+        tamaños_ventana[v] = kaio_medir(map_entrada, longitud, &total_asteriscos);
+        tamaño_intermedio += tamaños_ventana[v];
+        madvise(map_entrada, longitud, MADV_DONTNEED);
+        munmap(map_entrada, longitud);
+    }
+
+    char buffer_contador_asteriscos[KAIO_MAX_FOOTER];
+    int tam_contador = kaio_footer(buffer_contador_asteriscos, total_asteriscos);
+
+    int descriptor_salida = crear_salida(salidafile, tamaño_intermedio + (size_t)tam_contador);
+    if (descriptor_salida < 0) {
+        free(tamaños_ventana);
+        return -1;
+    }
+
+    // Fase 2: transformar cada ventana de entrada en su ventana de salida
+    size_t pos_salida = 0;
+    for (size_t v = 0; v < n_ventanas; v++) {
+        size_t offset = v * ventana;
+        size_t longitud = tamaño_entrada - offset < ventana ? tamaño_entrada - offset : ventana;
+        char *map_entrada = proyectar_entrada(descriptor_entrada, longitud, offset);
+        if (map_entrada == MAP_FAILED) {
+            perror("mmap ventana entrada");
+            free(tamaños_ventana);
+            close(descriptor_salida);
+            return -1;
+        }
+        madvise(map_entrada, longitud, MADV_SEQUENTIAL);
+
+        // la proyección de salida empieza en la página que contiene pos_salida
+        size_t inicio_salida = pos_salida / pagina * pagina;
+        size_t desfase = pos_salida - inicio_salida;
+        size_t longitud_salida = desfase + tamaños_ventana[v];
+        if (tamaños_ventana[v] > 0) {
+            char *map_salida = proyectar_salida(descriptor_salida, longitud_salida, inicio_salida);
+            if (map_salida == MAP_FAILED) {
+                perror("mmap ventana salida");
+                munmap(map_entrada, longitud);
+                free(tamaños_ventana);
+                close(descriptor_salida);
+                return -1;
+            }
+            kaio_transformar(map_entrada, longitud, map_salida + desfase);
+            // las páginas sucias siguen en la caché de páginas del archivo
+            madvise(map_salida, longitud_salida, MADV_DONTNEED);
+            munmap(map_salida, longitud_salida);
+        }
+        pos_salida += tamaños_ventana[v];
+
+        madvise(map_entrada, longitud, MADV_DONTNEED);
+        munmap(map_entrada, longitud);
+    }
+    free(tamaños_ventana);
+
+    // Escribimos el footer al final y aplicamos la durabilidad pedida
+    int resultado = 0;
+    if (pwrite(descriptor_salida, buffer_contador_asteriscos, (size_t)tam_contador, (off_t) tamaño_intermedio) != tam_contador) {
+        perror("pwrite footer");
+        resultado = -1;
+    } else {
+        resultado = aplicar_durabilidad(descriptor_salida, salidafile);
+    }
+    close(descriptor_salida);
+    return resultado;
+}
+
+// --- MODO INCREMENTAL (--incremental) ---
+// Para entradas que solo crecen (logs): junto a la salida se guarda un punto
+// de control, <salida>.kaio, con lo procesado hasta ahora. En la siguiente
+// ejecución, si el final de lo ya procesado no ha cambiado y la salida es la
+// que se dejó, solo se transforman los bytes añadidos: la salida se alarga en
+// su sitio (los datos nuevos pisan el footer viejo) y se reescribe el footer.
+// Si algo no cuadra se procesa la entrada entera, como sin la opción.
+
+#define MAGIA_CONTROL   "KAIOPC1"
+#define TAM_COLA        4096    // bytes del final de lo procesado que se comparan
+
+struct punto_control {
+    char magia[8];
+    uint64_t bytes_entrada;     // entrada ya procesada
+    uint64_t bytes_salida;      // salida sin footer
+    uint64_t asteriscos;
+    uint64_t hash_cola;         // FNV-1a de los últimos TAM_COLA bytes procesados
+    struct kaio_reglas reglas;  // con otras reglas la salida no sirve
+};
+
+static int hash_cola(int descriptor, uint64_t fin, uint64_t *hash) {
+    char cola[TAM_COLA];
+    size_t n = fin < TAM_COLA ? (size_t) fin : TAM_COLA;
+    if (pread(descriptor, cola, n, (off_t)(fin - n)) != (ssize_t) n)
+        return -1;
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (unsigned char) cola[i];
+        h *= 1099511628211ULL;
+    }
+    *hash = h;
+    return 0;
+}
+
+// Devuelve 1 si el punto de control sirve para seguir donde se quedó
+static int control_valido(const char *nombre_control, struct punto_control *pc, int descriptor_entrada,
+                          size_t tamaño_entrada, int descriptor_salida) {
+    int descriptor = open(nombre_control, O_RDONLY);
+    if (descriptor < 0)
+        return 0;
+    ssize_t leidos = read(descriptor, pc, sizeof(*pc));
+    close(descriptor);
+
+    const struct kaio_reglas *reglas = kaio_reglas_activas();
+    if (leidos != (ssize_t) sizeof(*pc) || memcmp(pc->magia, MAGIA_CONTROL, sizeof(pc->magia)) != 0 ||
+        pc->reglas.relleno != reglas->relleno || pc->reglas.letras != reglas->letras ||
+        pc->reglas.digitos != reglas->digitos)
+        return 0;
+
+    // la entrada no puede haber encogido ni cambiado por el final de lo procesado
+    uint64_t hash;
+    if (pc->bytes_entrada > tamaño_entrada || hash_cola(descriptor_entrada, pc->bytes_entrada, &hash) < 0 ||
+        hash != pc->hash_cola)
+        return 0;
+
+    // y la salida tiene que acabar en el footer que se escribió
+    char footer[KAIO_MAX_FOOTER], leido[KAIO_MAX_FOOTER];
+    int tam_contador = kaio_footer(footer, pc->asteriscos);
+    struct stat st;
+    if (fstat(descriptor_salida, &st) < 0 || (uint64_t) st.st_size != pc->bytes_salida + (uint64_t) tam_contador)
+        return 0;
+    if (pread(descriptor_salida, leido, (size_t) tam_contador, (off_t) pc->bytes_salida) != tam_contador ||
+        memcmp(leido, footer, (size_t) tam_contador) != 0)
+        return 0;
+    return 1;
+}
+
+// Escribe el punto de control en un temporal y lo renombra: nunca queda a medias.
+// Solo se fuerza al disco si también se forzó la salida (--durability=data o
+// full); con none o async, tras un corte puede describir datos que no llegaron.
+static int escribir_control(const char *nombre_control, const struct punto_control *pc) {
+    char temporal[PATH_MAX + 8];
+    snprintf(temporal, sizeof(temporal), "%s.tmp", nombre_control);
+    int descriptor = open(temporal, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (descriptor < 0) {
+        perror("open punto de control");
+        return -1;
+    }
+    if (write(descriptor, pc, sizeof(*pc)) != (ssize_t) sizeof(*pc) ||
+        (durabilidad >= DURABILIDAD_DATA && fsync(descriptor) == -1)) {
+        perror("write punto de control");
+        close(descriptor);
+        unlink(temporal);
+        return -1;
+    }
+    close(descriptor);
+    if (rename(temporal, nombre_control) == -1) {
+        perror("rename punto de control");
+        unlink(temporal);
+        return -1;
+    }
+    // con full, también el renombrado
+    return durabilidad == DURABILIDAD_FULL ? sincronizar_directorio(nombre_control) : 0;
+}
+
+static int procesar_incremental(int descriptor_entrada, size_t tamaño_entrada, const char *salidafile) {
+    size_t pagina = (size_t) sysconf(_SC_PAGESIZE);
+    char nombre_control[PATH_MAX];
+    if (snprintf(nombre_control, sizeof(nombre_control), "%s.kaio", salidafile) >= (int) sizeof(nombre_control)) {
+        fprintf(stderr, "Nombre de salida demasiado largo.\n");
+        return -1;
+    }
+
+    struct punto_control pc;
+    int descriptor_salida = open(salidafile, O_RDWR);
+    int reanudar = descriptor_salida >= 0 &&
+                   control_valido(nombre_control, &pc, descriptor_entrada, tamaño_entrada, descriptor_salida);
+    if (!reanudar) {
+        if (descriptor_salida >= 0)
+            close(descriptor_salida);
+        memset(&pc, 0, sizeof(pc));
+        memcpy(pc.magia, MAGIA_CONTROL, sizeof(pc.magia));
+        pc.reglas = *kaio_reglas_activas();
+    }
+
+    // solo se proyecta lo añadido, desde la página que contiene el primer byte nuevo
+    size_t desde = (size_t) pc.bytes_entrada;
+    size_t nuevos = tamaño_entrada - desde;
+    size_t inicio_entrada = desde / pagina * pagina;
+    size_t desfase_entrada = desde - inicio_entrada;
+    char *map_entrada = NULL;
+    uint64_t total_asteriscos = pc.asteriscos;
+    size_t tamaño_nuevo = 0;
+    if (nuevos > 0) {
+        map_entrada = proyectar_entrada(descriptor_entrada, desfase_entrada + nuevos, inicio_entrada);
+        if (map_entrada == MAP_FAILED) {
+            perror("mmap entrada");
+            if (reanudar)
+                close(descriptor_salida);
+            return -1;
+        }
+        tamaño_nuevo = kaio_medir(map_entrada + desfase_entrada, nuevos, &total_asteriscos);
+    }
+
+    char buffer_contador_asteriscos[KAIO_MAX_FOOTER];
+    int tam_contador = kaio_footer(buffer_contador_asteriscos, total_asteriscos);
+    size_t tamaño_intermedio = (size_t) pc.bytes_salida + tamaño_nuevo;
+    size_t tamaño_final = tamaño_intermedio + (size_t) tam_contador;
+
+    // al reanudar la salida solo crece: lo ya escrito no se toca
+    if (!reanudar) {
+        descriptor_salida = crear_salida(salidafile, tamaño_final);
+    } else if (ftruncate(descriptor_salida, (off_t) tamaño_final) == -1) {
+        perror("ftruncate salida");
+        close(descriptor_salida);
+        descriptor_salida = -1;
+    }
+    if (descriptor_salida < 0) {
+        if (map_entrada != NULL)
+            munmap(map_entrada, desfase_entrada + nuevos);
+        return -1;
+    }
+
+    int resultado = 0;
+    if (tamaño_nuevo > 0) {
+        size_t inicio_salida = (size_t) pc.bytes_salida / pagina * pagina;
+        size_t desfase_salida = (size_t) pc.bytes_salida - inicio_salida;
+        char *map_salida = proyectar_salida(descriptor_salida, desfase_salida + tamaño_nuevo, inicio_salida);
+        if (map_salida == MAP_FAILED) {
+            perror("mmap salida");
+            resultado = -1;
+        } else {
+            kaio_transformar(map_entrada + desfase_entrada, nuevos, map_salida + desfase_salida);
+            munmap(map_salida, desfase_salida + tamaño_nuevo);
+        }
+    }
+    if (map_entrada != NULL)
+        munmap(map_entrada, desfase_entrada + nuevos);
+
+    // footer y punto de control van después de los datos: si la ejecución se
+    // corta antes, la salida no cuadra con el control y la próxima empieza de cero
+    if (resultado == 0 && pwrite(descriptor_salida, buffer_contador_asteriscos, (size_t) tam_contador,
+                                 (off_t) tamaño_intermedio) != tam_contador) {
+        perror("pwrite footer");
+        resultado = -1;
+    }
+    if (resultado == 0)
+        resultado = aplicar_durabilidad(descriptor_salida, salidafile);
+    close(descriptor_salida);
+    if (resultado < 0)
+        return -1;
+
+    pc.bytes_entrada = tamaño_entrada;
+    pc.bytes_salida = tamaño_intermedio;
+    pc.asteriscos = total_asteriscos;
+    if (hash_cola(descriptor_entrada, tamaño_entrada, &pc.hash_cola) < 0) {
+        perror("pread entrada");
+        return -1;
+    }
+    if (escribir_control(nombre_control, &pc) < 0)
+        return -1;
+
+    printf("Incremental: %zu bytes nuevos de entrada (%zu ya procesados)%s\n", nuevos, desde,
+           reanudar ? "" : ", sin punto de control válido");
+    return 0;
+}
+
+// --- MODO TUBERÍA ('-' como entrada o salida) ---
+// Para usar kaio en medio de una tubería (zcat x | kaio - - | ...) no hay
+// fstat ni mmap posibles: tres procesos (lector, transformador y escritor) se
+// pasan trozos por un anillo de N_RANURAS ranuras en memoria compartida.
+// Cada etapa publica con un contador futex cuántos trozos ha terminado. La
+// transformación es byte a byte, así que un dígito nunca queda partido entre
+// dos trozos. El total de asteriscos no se conoce hasta el final y se escribe
+// como footer al terminar.
+
+#define TAM_TROZO_TUBERIA (1 << 20)
+#define N_RANURAS 3
+
+struct ranura {
+    size_t longitud_entrada;    // 0: fin de la entrada
+    size_t longitud_salida;
+    char entrada[TAM_TROZO_TUBERIA];
+    char salida[9 * TAM_TROZO_TUBERIA];
+};
+
+struct tuberia {
+    int leidos;             // palabras futex: trozos terminados por cada etapa
+    int transformados;
+    int escritos;
+    int error;
+    int descriptor_entrada;
+    int descriptor_salida;
+    struct kaio_estado estado;  // cuentas de la transformación incremental
+    struct ranura ranuras[N_RANURAS];
+};
+
+// Marca el error y despierta a todas las etapas para que terminen
+static void abortar_tuberia(struct tuberia *t) {
+    __atomic_store_n(&t->error, 1, __ATOMIC_RELEASE);
+    publicar_estado(&t->leidos, INT_MAX);
+    publicar_estado(&t->transformados, INT_MAX);
+    publicar_estado(&t->escritos, INT_MAX);
+}
+
+static int tuberia_abortada(struct tuberia *t) {
+    return __atomic_load_n(&t->error, __ATOMIC_ACQUIRE);
+}
+
+// Escribe 'n' bytes completos aunque write() haga escrituras parciales
+static int escribir_todo(int descriptor, const char *datos, size_t n) {
+    while (n > 0) {
+        ssize_t escritos = write(descriptor, datos, n);
+        if (escritos < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        datos += escritos;
+        n -= (size_t) escritos;
+    }
+    return 0;
+}
+
+static void etapa_lectura(struct tuberia *t) {
+    for (int i = 0; ; i++) {
+        // esperar a que el escritor libere la ranura
+        esperar_estado(&t->escritos, i - N_RANURAS + 1);
+        if (tuberia_abortada(t))
+            return;
+
+        struct ranura *r = &t->ranuras[i % N_RANURAS];
+        size_t leidos = 0;
+        while (leidos < TAM_TROZO_TUBERIA) {
+            ssize_t n = read(t->descriptor_entrada, r->entrada + leidos, TAM_TROZO_TUBERIA - leidos);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                perror("read entrada");
+                abortar_tuberia(t);
+                return;
+            }
+            if (n == 0)
+                break;
+            leidos += (size_t) n;
+        }
+        r->longitud_entrada = leidos;
+        publicar_estado(&t->leidos, i + 1);
+        if (leidos == 0)
+            return; // trozo vacío: fin de la entrada
+    }
+}
+
+static void etapa_transformacion(struct tuberia *t) {
+    for (int i = 0; ; i++) {
+        esperar_estado(&t->leidos, i + 1);
+        if (tuberia_abortada(t))
+            return;
+
+        // la longitud se copia antes de publicar: después la ranura ya no es nuestra
+        struct ranura *r = &t->ranuras[i % N_RANURAS];
+        size_t longitud = r->longitud_entrada;
+        r->longitud_salida = kaio_procesar(&t->estado, r->entrada, longitud, r->salida);
+        publicar_estado(&t->transformados, i + 1);
+        if (longitud == 0)
+            return;
+    }
+}
+
+static void etapa_escritura(struct tuberia *t) {
+    // si el lector de la tubería se va, write() devuelve EPIPE en vez de matarnos
+    signal(SIGPIPE, SIG_IGN);
+
+    for (int i = 0; ; i++) {
+        esperar_estado(&t->transformados, i + 1);
+        if (tuberia_abortada(t))
+            return;
+
+        struct ranura *r = &t->ranuras[i % N_RANURAS];
+        if (r->longitud_entrada == 0) {
+            // fin: el footer va detrás del último trozo
+            char buffer_contador_asteriscos[KAIO_MAX_FOOTER];
+            size_t tam_contador = kaio_terminar(&t->estado, buffer_contador_asteriscos);
+            if (escribir_todo(t->descriptor_salida, buffer_contador_asteriscos, tam_contador) < 0) {
+                perror("write salida");
+                abortar_tuberia(t);
+            }
+            return;
+        }
+        if (escribir_todo(t->descriptor_salida, r->salida, r->longitud_salida) < 0) {
+            perror("write salida");
+            abortar_tuberia(t);
+            return;
+        }
+        publicar_estado(&t->escritos, i + 1);
+    }
+}
+
+static void etapa_tuberia(int id, void *arg) {
+    struct tuberia *t = arg;
+    if (id == 0)
+        etapa_lectura(t);
+    else if (id == 1)
+        etapa_transformacion(t);
+    else
+        etapa_escritura(t);
+}
+
+static int procesar_tuberia(const char *entradafile, const char *salidafile) {
+    int descriptor_entrada = STDIN_FILENO;
+    if (strcmp(entradafile, "-") != 0) {
+        descriptor_entrada = open(entradafile, O_RDONLY);
+        if (descriptor_entrada < 0) {
+            perror("open entrada");
+            return -1;
+        }
+    }
+
+    int descriptor_salida = STDOUT_FILENO;
+    if (strcmp(salidafile, "-") != 0) {
+        descriptor_salida = open(salidafile, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (descriptor_salida < 0) {
+            perror("open salida");
+            if (descriptor_entrada != STDIN_FILENO)
+                close(descriptor_entrada);
+            return -1;
+        }
+    }
+
+    int resultado = -1;
+    struct tuberia *t = reservar_anonima(sizeof(struct tuberia), MAP_SHARED);
+    if (t == MAP_FAILED) {
+        perror("mmap tuberia");
+    } else {
+        t->descriptor_entrada = descriptor_entrada;
+        t->descriptor_salida = descriptor_salida;
+        kaio_iniciar(&t->estado);
+        if (lanzar_trabajadores(3, etapa_tuberia, t) == 0 && !tuberia_abortada(t))
+            resultado = 0;
+        // una tubería o un terminal no se sincronizan
+        if (resultado == 0 && descriptor_salida != STDOUT_FILENO)
+            resultado = aplicar_durabilidad(descriptor_salida, salidafile);
+        liberar_anonima(t, sizeof(struct tuberia));
+    }
+
+    if (descriptor_entrada != STDIN_FILENO)
+        close(descriptor_entrada);
+    if (descriptor_salida != STDOUT_FILENO)
+        close(descriptor_salida);
+    return resultado;
+}
+
+// --- BACKEND io_uring (--io=uring) ---
+// En lugar de fallos de página sobre proyecciones, la entrada se lee y la
+// salida se escribe con io_uring, con URING_RANURAS trozos en vuelo a la vez.
+// Los trozos se leen en orden, se transforman en orden en cuanto su lectura ha
+// terminado (así su offset de salida es la suma de los anteriores y basta una
+// pasada) y se escriben sin esperar. Los buffers se registran en el anillo
+// (READ_FIXED / WRITE_FIXED); si el kernel no deja registrarlos se usan
+// lecturas y escrituras normales. Se usan las llamadas al sistema directamente,
+// sin liburing.
+
+#define URING_RANURAS       8
+#define TAM_TROZO_URING     (256 * 1024)
+
+#define RANURA_LIBRE        0
+#define RANURA_LEYENDO      1
+#define RANURA_LEIDA        2
+#define RANURA_ESCRIBIENDO  3
+
+struct anillo {
+    int fd;
+    unsigned *sq_cola, *sq_mascara, *sq_indices;
+    unsigned *cq_cabeza, *cq_cola, *cq_mascara;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *map_sq, *map_cq;
+    size_t tamaño_sq, tamaño_cq, tamaño_sqes;
+    unsigned por_enviar;    // sqes preparados que aún no se han enviado
+    unsigned en_vuelo;      // operaciones cuyo cqe aún no hemos recogido
+};
+
+struct ranura_uring {
+    int estado;
+    size_t offset_entrada;
+    size_t longitud;        // bytes de entrada del trozo
+    size_t hechos;          // bytes ya leídos o ya escritos
+    size_t longitud_salida;
+    size_t offset_salida;
+    char *entrada;
+    char *salida;
+};
+
+static int iniciar_anillo(struct anillo *a, unsigned entradas) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    a->fd = (int) syscall(__NR_io_uring_setup, entradas, &p);
+    if (a->fd < 0)
+        return -1;
+
+    a->tamaño_sq = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    a->tamaño_cq = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    a->tamaño_sqes = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    a->map_sq = mmap(NULL, a->tamaño_sq, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, a->fd, IORING_OFF_SQ_RING);
+    a->map_cq = mmap(NULL, a->tamaño_cq, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, a->fd, IORING_OFF_CQ_RING);
+    a->sqes = mmap(NULL, a->tamaño_sqes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, a->fd, IORING_OFF_SQES);
+    if (a->map_sq == MAP_FAILED || a->map_cq == MAP_FAILED || a->sqes == MAP_FAILED) {
+        perror("mmap io_uring");
+        close(a->fd);
+        return -1;
+    }
+
+    char *sq = a->map_sq, *cq = a->map_cq;
+    a->sq_cola = (unsigned *) (sq + p.sq_off.tail);
+    a->sq_mascara = (unsigned *) (sq + p.sq_off.ring_mask);
+    a->sq_indices = (unsigned *) (sq + p.sq_off.array);
+    a->cq_cabeza = (unsigned *) (cq + p.cq_off.head);
+    a->cq_cola = (unsigned *) (cq + p.cq_off.tail);
+    a->cq_mascara = (unsigned *) (cq + p.cq_off.ring_mask);
+    a->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+    a->por_enviar = 0;
+    a->en_vuelo = 0;
+    return 0;
+}
+
+static void cerrar_anillo(struct anillo *a) {
+    munmap(a->sqes, a->tamaño_sqes);
+    munmap(a->map_cq, a->tamaño_cq);
+    munmap(a->map_sq, a->tamaño_sq);
+    close(a->fd);
+}
+
+// Prepara una lectura o escritura; el kernel la ve al llamar a enviar_y_esperar
+static void preparar_es(struct anillo *a, int operacion, int fd, void *buffer, size_t n, size_t offset,
+                        int indice_buffer, uint64_t etiqueta) {
+    unsigned cola = *a->sq_cola;
+    unsigned indice = cola & *a->sq_mascara;
+    struct io_uring_sqe *sqe = &a->sqes[indice];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (uint8_t) operacion;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) (uintptr_t) buffer;
+    sqe->len = (uint32_t) n;
+    sqe->off = offset;
+    sqe->buf_index = (uint16_t) (indice_buffer < 0 ? 0 : indice_buffer);
+    sqe->user_data = etiqueta;
+    a->sq_indices[indice] = indice;
+    __atomic_store_n(a->sq_cola, cola + 1, __ATOMIC_RELEASE);
+    a->por_enviar++;
+    a->en_vuelo++;
+}
+
+static int enviar_y_esperar(struct anillo *a, unsigned minimo) {
+    for (;;) {
+        long r = syscall(__NR_io_uring_enter, a->fd, a->por_enviar, minimo, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (r >= 0) {
+            a->por_enviar -= (unsigned) r;
+            return 0;
+        }
+        if (errno != EINTR)
+            return -1;
+    }
+}
+
+static int siguiente_cqe(struct anillo *a, struct io_uring_cqe *cqe) {
+    unsigned cabeza = *a->cq_cabeza;
+    if (cabeza == __atomic_load_n(a->cq_cola, __ATOMIC_ACQUIRE))
+        return 0;
+    *cqe = a->cqes[cabeza & *a->cq_mascara];
+    __atomic_store_n(a->cq_cabeza, cabeza + 1, __ATOMIC_RELEASE);
+    a->en_vuelo--;
+    return 1;
+}
+
+// Envía (o reenvía, si la anterior fue parcial) la lectura de una ranura
+static void pedir_lectura(struct anillo *a, struct ranura_uring *r, int i, int fd, int fijos) {
+    preparar_es(a, fijos ? IORING_OP_READ_FIXED : IORING_OP_READ, fd, r->entrada + r->hechos,
+                r->longitud - r->hechos, r->offset_entrada + r->hechos, fijos ? i : -1, (uint64_t) i * 2);
+}
+
+static void pedir_escritura(struct anillo *a, struct ranura_uring *r, int i, int fd, int fijos) {
+    preparar_es(a, fijos ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, fd, r->salida + r->hechos,
+                r->longitud_salida - r->hechos, r->offset_salida + r->hechos,
+                fijos ? URING_RANURAS + i : -1, (uint64_t) i * 2 + 1);
+}
+
+// Devuelve 0 si terminó bien, -1 si hubo error y 1 si io_uring no está
+// disponible (el llamador vuelve entonces al camino con mmap)
+static int procesar_uring(int descriptor_entrada, size_t tamaño_entrada, const char *salidafile) {
+    struct anillo anillo;
+    if (iniciar_anillo(&anillo, 2 * URING_RANURAS) < 0) {
+        fprintf(stderr, "io_uring no disponible (%s), se usa mmap.\n", strerror(errno));
         return 1;
     }
 
-    char *entradafile = argv[1];
-    char *salidafile = argv[2];
+    size_t tamaño_buffers = URING_RANURAS * (size_t) 10 * TAM_TROZO_URING;
+    char *buffers = reservar_anonima(tamaño_buffers, MAP_PRIVATE);
+    if (buffers == MAP_FAILED) {
+        perror("mmap buffers io_uring");
+        cerrar_anillo(&anillo);
+        return -1;
+    }
+
+    struct ranura_uring ranuras[URING_RANURAS];
+    struct iovec iov[2 * URING_RANURAS];
+    for (int i = 0; i < URING_RANURAS; i++) {
+        ranuras[i].estado = RANURA_LIBRE;
+        ranuras[i].entrada = buffers + (size_t) i * TAM_TROZO_URING;
+        ranuras[i].salida = buffers + (size_t) URING_RANURAS * TAM_TROZO_URING + (size_t) i * 9 * TAM_TROZO_URING;
+        iov[i].iov_base = ranuras[i].entrada;
+        iov[i].iov_len = TAM_TROZO_URING;
+        iov[URING_RANURAS + i].iov_base = ranuras[i].salida;
+        iov[URING_RANURAS + i].iov_len = 9 * TAM_TROZO_URING;
+    }
+    int fijos = syscall(__NR_io_uring_register, anillo.fd, IORING_REGISTER_BUFFERS, iov, 2 * URING_RANURAS) == 0;
+
+    int descriptor_salida = open(salidafile, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (descriptor_salida < 0) {
+        perror("open salida");
+        liberar_anonima(buffers, tamaño_buffers);
+        cerrar_anillo(&anillo);
+        return -1;
+    }
+
+    size_t n_trozos = (tamaño_entrada + TAM_TROZO_URING - 1) / TAM_TROZO_URING;
+    size_t siguiente_lectura = 0;       // próximo trozo a leer
+    size_t siguiente_transformar = 0;   // próximo trozo a transformar (en orden)
+    size_t completados = 0;             // trozos ya escritos del todo
+    size_t pos_salida = 0;
+    struct kaio_estado estado;
+    kaio_iniciar(&estado);
+    int resultado = 0;
+
+    while (completados < n_trozos && resultado == 0) {
+        // lecturas nuevas en las ranuras libres, siempre en orden
+        while (siguiente_lectura < n_trozos && ranuras[siguiente_lectura % URING_RANURAS].estado == RANURA_LIBRE) {
+            int i = (int) (siguiente_lectura % URING_RANURAS);
+            struct ranura_uring *r = &ranuras[i];
+            r->offset_entrada = siguiente_lectura * TAM_TROZO_URING;
+            r->longitud = tamaño_entrada - r->offset_entrada < TAM_TROZO_URING
+                        ? tamaño_entrada - r->offset_entrada : TAM_TROZO_URING;
+            r->hechos = 0;
+            r->estado = RANURA_LEYENDO;
+            pedir_lectura(&anillo, r, i, descriptor_entrada, fijos);
+            siguiente_lectura++;
+        }
+
+        // transformar en orden lo que ya se ha leído y mandarlo a escribir
+        while (siguiente_transformar < siguiente_lectura
+               && ranuras[siguiente_transformar % URING_RANURAS].estado == RANURA_LEIDA) {
+            int i = (int) (siguiente_transformar % URING_RANURAS);
+            struct ranura_uring *r = &ranuras[i];
+            r->longitud_salida = kaio_procesar(&estado, r->entrada, r->longitud, r->salida);
+            r->offset_salida = pos_salida;
+            r->hechos = 0;
+            pos_salida += r->longitud_salida;
+            if (r->longitud_salida == 0) {
+                r->estado = RANURA_LIBRE;
+                completados++;
+            } else {
+                r->estado = RANURA_ESCRIBIENDO;
+                pedir_escritura(&anillo, r, i, descriptor_salida, fijos);
+            }
+            siguiente_transformar++;
+        }
+        if (completados == n_trozos)
+            break;
+
+        if (enviar_y_esperar(&anillo, 1) < 0) {
+            perror("io_uring_enter");
+            resultado = -1;
+            break;
+        }
+
+        struct io_uring_cqe cqe;
+        while (siguiente_cqe(&anillo, &cqe)) {
+            int i = (int) (cqe.user_data / 2);
+            int es_escritura = (int) (cqe.user_data % 2);
+            struct ranura_uring *r = &ranuras[i];
+            if (cqe.res <= 0) {
+                // 0 en una lectura: el archivo se ha encogido mientras lo leíamos
+                fprintf(stderr, "%s io_uring: %s\n", es_escritura ? "write" : "read",
+                        cqe.res < 0 ? strerror(-cqe.res) : "fin de archivo inesperado");
+                resultado = -1;
+                continue;
+            }
+            r->hechos += (size_t) cqe.res;
+            if (!es_escritura) {
+                if (r->hechos < r->longitud) {
+                    // lectura parcial: pedimos el resto
+                    pedir_lectura(&anillo, r, i, descriptor_entrada, fijos);
+                } else {
+                    r->estado = RANURA_LEIDA;
+                }
+            } else if (r->hechos < r->longitud_salida) {
+                pedir_escritura(&anillo, r, i, descriptor_salida, fijos);
+            } else {
+                r->estado = RANURA_LIBRE;
+                completados++;
+            }
+        }
+    }
+
+    if (resultado < 0) {
+        // esperamos a que no quede nada en vuelo antes de liberar los buffers
+        struct io_uring_cqe cqe;
+        while (anillo.en_vuelo > 0 && enviar_y_esperar(&anillo, 1) == 0)
+            while (siguiente_cqe(&anillo, &cqe))
+                ;
+        cerrar_anillo(&anillo);
+        liberar_anonima(buffers, tamaño_buffers);
+        close(descriptor_salida);
+        return -1;
+    }
+
+    // Escribimos el footer al final y aplicamos la durabilidad pedida
+    char buffer_contador_asteriscos[KAIO_MAX_FOOTER];
+    int tam_contador = kaio_footer(buffer_contador_asteriscos, estado.asteriscos);
+    if (pwrite(descriptor_salida, buffer_contador_asteriscos, (size_t)tam_contador, (off_t) pos_salida) != tam_contador) {
+        perror("pwrite footer");
+        resultado = -1;
+    } else {
+        resultado = aplicar_durabilidad(descriptor_salida, salidafile);
+    }
+
+    cerrar_anillo(&anillo);
+    liberar_anonima(buffers, tamaño_buffers);
+    close(descriptor_salida);
+    return resultado;
+}
+
+// --- SALIDA SIN CACHÉ (--io=directo) ---
+// Para ejecuciones muy grandes en máquinas compartidas: kaio no debe llenar
+// la caché de páginas y echar de ella lo que usan los demás. La entrada se lee
+// por trozos y cada trozo leído se descarta de la caché (POSIX_FADV_DONTNEED).
+// La salida se escribe con O_DIRECT desde un buffer alineado: solo se escriben
+// bloques completos y lo que sobra pasa al principio del trozo siguiente; el
+// último bloque va relleno y al final se recorta el archivo a su tamaño. Si el
+// sistema de archivos no admite O_DIRECT (tmpfs, por ejemplo) se escribe
+// normalmente y cada trozo, una vez en disco (sync_file_range), se descarta.
+
+#define TAM_TROZO_DIRECTO   (1 << 20)   // entrada por trozo
+#define TAM_FOLIO_MAXIMO    (2 << 20)   // folio más grande de la caché de páginas
+
+struct salida_directa {
+    int descriptor;
+    int directo;            // 0: sin O_DIRECT, se descarta a mano
+    off_t pos_anterior;     // trozo anterior, pendiente de descartar
+    size_t longitud_anterior;
+    off_t descartado;       // hasta aquí ya se ha descartado
+};
+
+// Descarta de la caché [*desde, hasta). POSIX_FADV_DONTNEED deja los folios
+// que solo están en parte dentro del rango, y con folios grandes un trozo de
+// 1 MiB casi nunca contiene uno entero: el último folio se vuelve a pedir en
+// la llamada siguiente.
+static void descartar_cache(int descriptor, off_t *desde, off_t hasta) {
+    posix_fadvise(descriptor, *desde, hasta - *desde, POSIX_FADV_DONTNEED);
+    *desde = hasta / TAM_FOLIO_MAXIMO * TAM_FOLIO_MAXIMO;
+}
+
+// Escribe un trozo alineado en 'offset'. Si O_DIRECT falla en la primera
+// escritura (hay sistemas que lo aceptan en open pero no al escribir),
+// seguimos sin él.
+static int escribir_directo(struct salida_directa *s, const char *datos, size_t n, off_t offset) {
+    size_t escritos = 0;
+    while (escritos < n) {
+        ssize_t r = pwrite(s->descriptor, datos + escritos, n - escritos, offset + (off_t) escritos);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0 && errno == EINVAL && s->directo && offset == 0 && escritos == 0) {
+            fprintf(stderr, "O_DIRECT no disponible para la salida, se descarta la caché a mano.\n");
+            s->directo = 0;
+            fcntl(s->descriptor, F_SETFL, fcntl(s->descriptor, F_GETFL) & ~O_DIRECT);
+            continue;
+        }
+        if (r < 0) {
+            perror("pwrite salida");
+            return -1;
+        }
+        escritos += (size_t) r;
+    }
+    if (s->directo)
+        return 0;
+
+    // sin O_DIRECT: se lanza la escritura de este trozo y, mientras tanto, se
+    // espera a la del anterior para sacarlo de la caché
+    sync_file_range(s->descriptor, offset, (off_t) n, SYNC_FILE_RANGE_WRITE);
+    if (s->longitud_anterior > 0) {
+        sync_file_range(s->descriptor, s->pos_anterior, (off_t) s->longitud_anterior,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        descartar_cache(s->descriptor, &s->descartado, s->pos_anterior + (off_t) s->longitud_anterior);
+    }
+    s->pos_anterior = offset;
+    s->longitud_anterior = n;
+    return 0;
+}
+
+static int procesar_directo(int descriptor_entrada, size_t tamaño_entrada, const char *salidafile) {
+    size_t alineacion = (size_t) sysconf(_SC_PAGESIZE);
+    // la salida de un trozo, más lo que sobró del anterior, el footer y el relleno
+    size_t tamaño_salida = KAIO_MAX_SALIDA(TAM_TROZO_DIRECTO) + KAIO_MAX_FOOTER + 2 * alineacion;
+    size_t tamaño_buffers = TAM_TROZO_DIRECTO + tamaño_salida;
+    char *buffers = reservar_anonima(tamaño_buffers, MAP_PRIVATE);
+    if (buffers == MAP_FAILED) {
+        perror("mmap buffers");
+        return -1;
+    }
+    char *entrada = buffers;
+    char *salida = buffers + TAM_TROZO_DIRECTO;     // alineado: el trozo es múltiplo de página
+
+    struct salida_directa s = { .directo = 1 };
+    s.descriptor = open(salidafile, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+    if (s.descriptor < 0 && errno == EINVAL) {
+        fprintf(stderr, "O_DIRECT no disponible para la salida, se descarta la caché a mano.\n");
+        s.directo = 0;
+        s.descriptor = open(salidafile, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    }
+    if (s.descriptor < 0) {
+        perror("open salida");
+        liberar_anonima(buffers, tamaño_buffers);
+        return -1;
+    }
+    posix_fadvise(descriptor_entrada, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    struct kaio_estado estado;
+    kaio_iniciar(&estado);
+    size_t pendientes = 0;      // bytes al principio de 'salida' aún sin escribir
+    off_t pos_salida = 0;       // offset del primero de ellos, siempre alineado
+    size_t pos = 0;
+    off_t entrada_descartada = 0;
+    int resultado = 0, fin = 0;
+    while (resultado == 0 && !fin) {
+        size_t longitud = tamaño_entrada - pos < TAM_TROZO_DIRECTO ? tamaño_entrada - pos : TAM_TROZO_DIRECTO;
+        size_t leidos = 0;
+        while (leidos < longitud) {
+            ssize_t n = pread(descriptor_entrada, entrada + leidos, longitud - leidos, (off_t) (pos + leidos));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                perror("pread entrada");
+                resultado = -1;
+                break;
+            }
+            leidos += (size_t) n;
+        }
+        if (resultado < 0)
+            break;
+        pendientes += kaio_procesar(&estado, entrada, longitud, salida + pendientes);
+        pos += longitud;
+        // lo leído ya no hace falta en la caché
+        descartar_cache(descriptor_entrada, &entrada_descartada, (off_t) pos);
+
+        size_t bloque = pendientes / alineacion * alineacion;
+        if (pos == tamaño_entrada) {
+            // último trozo: footer y relleno hasta el bloque completo
+            fin = 1;
+            pendientes += kaio_terminar(&estado, salida + pendientes);
+            bloque = (pendientes + alineacion - 1) / alineacion * alineacion;
+            memset(salida + pendientes, 0, bloque - pendientes);
+        }
+        if (bloque > 0)
+            resultado = escribir_directo(&s, salida, bloque, pos_salida);
+        if (!fin) {
+            memmove(salida, salida + bloque, pendientes - bloque);
+            pendientes -= bloque;
+            pos_salida += (off_t) bloque;
+        }
+    }
+
+    // se recorta el relleno, se descarta lo que quede y se aplica la durabilidad
+    posix_fadvise(descriptor_entrada, 0, 0, POSIX_FADV_DONTNEED);
+    if (resultado == 0 && ftruncate(s.descriptor, pos_salida + (off_t) pendientes) == -1) {
+        perror("ftruncate salida");
+        resultado = -1;
+    }
+    if (resultado == 0 && !s.directo && s.longitud_anterior > 0) {
+        sync_file_range(s.descriptor, s.pos_anterior, (off_t) s.longitud_anterior,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        posix_fadvise(s.descriptor, 0, 0, POSIX_FADV_DONTNEED);
+    }
+    if (resultado == 0)
+        resultado = aplicar_durabilidad(s.descriptor, salidafile);
+
+    close(s.descriptor);
+    liberar_anonima(buffers, tamaño_buffers);
+    return resultado;
+}
+
+// --- MODO CLÁSICO: padre (letras) e hijo (números) ---
+// La entrada se recorre en trozos de TAM_TROZO. El padre escribe el texto de
+// cada trozo y publica su progreso; el hijo escribe los asteriscos del trozo k
+// en cuanto el padre ha publicado el trozo k, así las dos etapas se solapan.
+// Con -t se guarda una traza con el inicio y el fin de cada trozo en cada etapa.
+
+#define ETAPA_TEXTO         0   // padre
+#define ETAPA_ASTERISCOS    1   // hijo
+
+struct traza_trozo {
+    uint64_t inicio[2];     // ns desde el arranque, por etapa
+    uint64_t fin[2];
+};
+
+// Escribe la traza en CSV: etapa,trozo,inicio_ns,fin_ns
+static int escribir_traza(const char *archivo_traza, const struct traza_trozo *traza, size_t n_trozos) {
+    FILE *f = fopen(archivo_traza, "w");
+    if (f == NULL) {
+        perror("fopen traza");
+        return -1;
+    }
+    static const char *nombres[2] = { "texto", "asteriscos" };
+    fprintf(f, "etapa,trozo,inicio_ns,fin_ns\n");
+    for (int etapa = 0; etapa < 2; etapa++)
+        for (size_t k = 0; k < n_trozos; k++)
+            fprintf(f, "%s,%zu,%" PRIu64 ",%" PRIu64 "\n", nombres[etapa], k,
+                    traza[k].inicio[etapa], traza[k].fin[etapa]);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+// Lo que comparten padre e hijo; el hijo lo recibe como argumento del trabajador
+struct padre_hijo {
+    const char *map_entrada;
+    size_t tamaño_entrada;
+    char *map_salida;
+    size_t n_trozos;
+    struct control *control;
+    struct traza_trozo *traza;  // NULL sin -t
+    uint64_t origen;
+};
+
+// --- HIJO (Maneja los NÚMEROS -> ASTERISCOS) ---
+static void etapa_asteriscos(int id, void *arg) {
+    struct padre_hijo *ph = arg;
+    struct marca marca;
+    (void) id;
+
+    size_t pos_salida = 0;
+    for (size_t k = 0; k < ph->n_trozos; k++) {
+        // Esperar a que el padre publique este trozo
+        empezar_fase(&marca);
+        esperar_estado(&ph->control->progreso, (int) k + 1);
+        terminar_fase(FASE_ESPERA, &marca);
+
+        size_t inicio = k * TAM_TROZO;
+        size_t longitud = ph->tamaño_entrada - inicio < TAM_TROZO ? ph->tamaño_entrada - inicio : TAM_TROZO;
+        if (ph->traza != NULL)
+            ph->traza[k].inicio[ETAPA_ASTERISCOS] = ahora_ns() - ph->origen;
+        // solo escribimos los asteriscos; el texto es del padre
+        empezar_fase(&marca);
+        pos_salida += kaio_transformar_modo(ph->map_entrada + inicio, longitud, ph->map_salida + pos_salida,
+                                            KAIO_MODO_ASTERISCOS);
+        terminar_fase(FASE_TRANSFORMACION, &marca);
+        if (ph->traza != NULL)
+            ph->traza[k].fin[ETAPA_ASTERISCOS] = ahora_ns() - ph->origen;
+    }
+}
+
+static int transformar_padre_hijo(const char *map_entrada, size_t tamaño_entrada, char *map_salida,
+                                  const char *archivo_traza) {
+
+    struct padre_hijo ph = { map_entrada, tamaño_entrada, map_salida, 0, NULL, NULL, 0 };
+    ph.n_trozos = (tamaño_entrada + TAM_TROZO - 1) / TAM_TROZO;
+    if (ph.n_trozos >= INT_MAX) {
+        fprintf(stderr, "Entrada demasiado grande para el modo padre/hijo.\n");
+        return -1;
+    }
+
+    // bloque de control para la sincronización padre/hijo
+    ph.control = mmap(NULL, sizeof(struct control), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (ph.control == MAP_FAILED) {
+        perror("mmap control");
+        return -1;
+    }
+    ph.control->progreso = 0;
+
+    // traza compartida: cada proceso rellena su etapa
+    size_t tamaño_traza = (ph.n_trozos + 1) * sizeof(struct traza_trozo);
+    ph.origen = ahora_ns();
+    if (archivo_traza != NULL) {
+        ph.traza = mmap(NULL, tamaño_traza, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (ph.traza == MAP_FAILED) {
+            perror("mmap traza");
+            munmap(ph.control, sizeof(struct control));
+            return -1;
+        }
+    }
+
+    // Crear el hijo (proceso, o hilo con --hilos)
+    struct grupo grupo;
+    if (iniciar_trabajadores(&grupo, 1, etapa_asteriscos, &ph) < 0) {
+        if (ph.traza != NULL)
+            munmap(ph.traza, tamaño_traza);
+        munmap(ph.control, sizeof(struct control));
+        return -1;
+    }
+
+    // --- PADRE (Maneja LETRAS -> MAYÚSCULAS) ---
+
+    // Letras a mayúsculas y resto de caracteres; en los dígitos sólo reservamos hueco
+    size_t pos_salida = 0;
+    for (size_t k = 0; k < ph.n_trozos; k++) {
+        size_t inicio = k * TAM_TROZO;
+        size_t longitud = tamaño_entrada - inicio < TAM_TROZO ? tamaño_entrada - inicio : TAM_TROZO;
+        if (ph.traza != NULL)
+            ph.traza[k].inicio[ETAPA_TEXTO] = ahora_ns() - ph.origen;
+        pos_salida += kaio_transformar_modo(map_entrada + inicio, longitud, map_salida + pos_salida, KAIO_MODO_TEXTO);
+        if (ph.traza != NULL)
+            ph.traza[k].fin[ETAPA_TEXTO] = ahora_ns() - ph.origen;
+
+        // Avisamos al hijo de que este trozo está listo
+        publicar_estado(&ph.control->progreso, (int) k + 1);
+    }
+
+    // Esperar a que el hijo termine
+    int resultado = esperar_trabajadores(&grupo);
+
+    if (ph.traza != NULL) {
+        if (resultado == 0 && escribir_traza(archivo_traza, ph.traza, ph.n_trozos) < 0)
+            resultado = -1;
+        munmap(ph.traza, tamaño_traza);
+    }
+    munmap(ph.control, sizeof(struct control));
+    return resultado;
+}
+
+// --- MODO LOTE (--batch) ---
+// Para muchos archivos pequeños: un único grupo de trabajadores (-j N, por
+// defecto uno por CPU) se mantiene vivo y va sacando pares entrada/salida de
+// una cola compartida (un índice que se incrementa atómicamente). Los archivos
+// de hasta UMBRAL_LOTE bytes se leen y escriben con read/write sobre buffers
+// de cada trabajador; los grandes siguen el camino con mmap.
+
+#define UMBRAL_LOTE (1 << 20)
+
+struct lote {
+    char **entradas;        // heredadas por los trabajadores, solo lectura
+    char **salidas;
+    size_t n;
+    size_t siguiente;       // cola: próximo par a procesar
+    size_t errores;
+    uint64_t ns_durabilidad;    // suma de lo que ha tardado --durability en todos
+};
+
+// Los dos devuelven 0 o el errno del fallo, guardado antes de cerrar y
+// desproyectar lo que haga falta (que pueden cambiar errno).
+
+// Archivo pequeño: entrada completa en 'buffer', salida en 'salida' (9 veces)
+static int lote_pequeño(int descriptor_entrada, size_t tamaño, const char *salidafile,
+                        char *buffer, char *salida, uint64_t *ns_durabilidad) {
+    size_t leidos = 0;
+    while (leidos < tamaño) {
+        ssize_t n = read(descriptor_entrada, buffer + leidos, tamaño - leidos);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return errno;
+        if (n == 0)
+            return EIO;     // el archivo ha encogido mientras se leía
+        leidos += (size_t) n;
+    }
+
+    size_t tamaño_final = kaio_convertir(buffer, tamaño, salida);
+
+    int descriptor_salida = open(salidafile, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (descriptor_salida < 0)
+        return errno;
+    int error = 0;
+    if (escribir_todo(descriptor_salida, salida, tamaño_final) < 0 ||
+        sincronizar_salida(descriptor_salida, salidafile, ns_durabilidad) < 0)
+        error = errno;
+    if (close(descriptor_salida) < 0 && error == 0)
+        error = errno;
+    return error;
+}
+
+// Archivo grande: el mismo esquema que el modo clásico, en un solo trabajador
+static int lote_grande(int descriptor_entrada, size_t tamaño, const char *salidafile,
+                       uint64_t *ns_durabilidad) {
+    char *map_entrada = proyectar_entrada(descriptor_entrada, tamaño, 0);
+    if (map_entrada == MAP_FAILED)
+        return errno;
+
+    uint64_t total_asteriscos = 0;
+    size_t tamaño_intermedio = kaio_medir(map_entrada, tamaño, &total_asteriscos);
+    char buffer_contador_asteriscos[KAIO_MAX_FOOTER];
+    int tam_contador = kaio_footer(buffer_contador_asteriscos, total_asteriscos);
+    size_t tamaño_final = tamaño_intermedio + (size_t)tam_contador;
+
+    int descriptor_salida = crear_salida(salidafile, tamaño_final);
+    if (descriptor_salida < 0) {
+        int error = errno;
+        munmap(map_entrada, tamaño);
+        return error;
+    }
+    char *map_salida = proyectar_salida(descriptor_salida, tamaño_final, 0);
+    if (map_salida == MAP_FAILED) {
+        int error = errno;
+        close(descriptor_salida);
+        munmap(map_entrada, tamaño);
+        return error;
+    }
+
+    kaio_transformar(map_entrada, tamaño, map_salida);
+    memcpy(map_salida + tamaño_intermedio, buffer_contador_asteriscos, (size_t)tam_contador);
+    munmap(map_entrada, tamaño);
+    munmap(map_salida, tamaño_final);
+    int error = sincronizar_salida(descriptor_salida, salidafile, ns_durabilidad) < 0 ? errno : 0;
+    close(descriptor_salida);
+    return error;
+}
 
-    // comprueba los nombres de archivo diferentes
-    if (strcmp(entradafile, salidafile) == 0) {
-        fprintf(stderr, "El archivo de salida debe ser diferente al de entrada.\n");
-        return 1;
+static void trabajar_lote(int id, void *arg) {
+    struct lote *l = arg;
+    (void) id;
+
+    char *buffer = malloc(UMBRAL_LOTE + (size_t) 9 * UMBRAL_LOTE + 64);
+    if (buffer == NULL) {
+        perror("malloc");
+        __atomic_fetch_add(&l->errores, 1, __ATOMIC_RELAXED);
+        return;
     }
+    char *salida = buffer + UMBRAL_LOTE;
 
-    // abrir entrada archivo y obtener tamaño
+    uint64_t ns_durabilidad = 0;
+    size_t i;
+    while ((i = __atomic_fetch_add(&l->siguiente, 1, __ATOMIC_RELAXED)) < l->n) {
+        int error;      // errno del fallo, 0 si todo fue bien
+        int descriptor_entrada = open(l->entradas[i], O_RDONLY);
+        struct stat st, st_salida;
+        if (descriptor_entrada < 0 || fstat(descriptor_entrada, &st) < 0) {
+            error = errno;
+        } else {
+            // otro nombre (enlace, "dir/../dir") para el mismo archivo: se
+            // truncaría mientras se lee
+            if (stat(l->salidas[i], &st_salida) == 0 && st_salida.st_dev == st.st_dev &&
+                st_salida.st_ino == st.st_ino) {
+                fprintf(stderr, "%s -> %s: la salida es el mismo archivo que la entrada\n",
+                        l->entradas[i], l->salidas[i]);
+                __atomic_fetch_add(&l->errores, 1, __ATOMIC_RELAXED);
+                close(descriptor_entrada);
+                continue;
+            }
+            if ((size_t) st.st_size <= UMBRAL_LOTE)
+                error = lote_pequeño(descriptor_entrada, (size_t) st.st_size, l->salidas[i], buffer, salida,
+                                     &ns_durabilidad);
+            else
+                error = lote_grande(descriptor_entrada, (size_t) st.st_size, l->salidas[i], &ns_durabilidad);
+        }
+        if (error != 0) {
+            fprintf(stderr, "%s -> %s: %s\n", l->entradas[i], l->salidas[i], strerror(error));
+            __atomic_fetch_add(&l->errores, 1, __ATOMIC_RELAXED);
+        }
+        if (descriptor_entrada >= 0)
+            close(descriptor_entrada);
+    }
+    __atomic_fetch_add(&l->ns_durabilidad, ns_durabilidad, __ATOMIC_RELAXED);
+    free(buffer);
+}
+
+// Añade un par a la lista; devuelve -1 si no hay memoria
+static int añadir_par(struct lote *l, size_t *capacidad, const char *entrada, const char *salida) {
+    if (l->n == *capacidad) {
+        *capacidad = *capacidad ? *capacidad * 2 : 1024;
+        char **entradas = realloc(l->entradas, *capacidad * sizeof(char *));
+        if (entradas != NULL)
+            l->entradas = entradas;
+        char **salidas = realloc(l->salidas, *capacidad * sizeof(char *));
+        if (salidas != NULL)
+            l->salidas = salidas;
+        if (entradas == NULL || salidas == NULL)
+            return -1;
+    }
+    l->entradas[l->n] = strdup(entrada);
+    l->salidas[l->n] = strdup(salida);
+    if (l->entradas[l->n] == NULL || l->salidas[l->n] == NULL)
+        return -1;
+    l->n++;
+    return 0;
+}
+
+// Lista de pares: una línea "entrada salida" por archivo
+static int leer_lista(struct lote *l, const char *lista) {
+    FILE *f = fopen(lista, "r");
+    if (f == NULL) {
+        perror("fopen lista");
+        return -1;
+    }
+    size_t capacidad = 0, numero_linea = 0;
+    char *linea = NULL;
+    size_t tam_linea = 0;
+    int resultado = 0;
+    while (resultado == 0 && getline(&linea, &tam_linea, f) != -1) {
+        numero_linea++;
+        char entrada[PATH_MAX], salida[PATH_MAX];
+        int campos = sscanf(linea, "%4095s %4095s", entrada, salida);
+        if (campos <= 0)
+            continue;   // línea vacía
+        if (campos != 2 || strcmp(entrada, salida) == 0) {
+            fprintf(stderr, "%s:%zu: se esperaba \"entrada salida\" (distintos).\n", lista, numero_linea);
+            resultado = -1;
+        } else if (añadir_par(l, &capacidad, entrada, salida) < 0) {
+            perror("malloc");
+            resultado = -1;
+        }
+    }
+    free(linea);
+    fclose(f);
+    return resultado;
+}
+
+// Directorio: cada archivo regular va al directorio de salida con el mismo nombre
+static int leer_directorio(struct lote *l, const char *directorio, const char *directorio_salida) {
+    // como en la lista, la salida no puede ser la entrada: cada archivo se
+    // truncaría mientras se lee
+    char ruta_entrada[PATH_MAX], ruta_salida[PATH_MAX];
+    if (realpath(directorio, ruta_entrada) == NULL || realpath(directorio_salida, ruta_salida) == NULL) {
+        perror("realpath");
+        return -1;
+    }
+    if (strcmp(ruta_entrada, ruta_salida) == 0) {
+        fprintf(stderr, "El directorio de salida debe ser diferente al de entrada.\n");
+        return -1;
+    }
+
+    DIR *d = opendir(directorio);
+    if (d == NULL) {
+        perror("opendir");
+        return -1;
+    }
+    size_t capacidad = 0;
+    int resultado = 0;
+    struct dirent *e;
+    while (resultado == 0 && (e = readdir(d)) != NULL) {
+        char entrada[PATH_MAX], salida[PATH_MAX];
+        struct stat st;
+        snprintf(entrada, sizeof(entrada), "%s/%s", directorio, e->d_name);
+        snprintf(salida, sizeof(salida), "%s/%s", directorio_salida, e->d_name);
+        if (stat(entrada, &st) < 0 || !S_ISREG(st.st_mode))
+            continue;
+        if (añadir_par(l, &capacidad, entrada, salida) < 0) {
+            perror("malloc");
+            resultado = -1;
+        }
+    }
+    closedir(d);
+    return resultado;
+}
+
+static int procesar_lote(const char *fuente, const char *directorio_salida, int n_trabajadores) {
+    struct lote *l = mmap(NULL, sizeof(struct lote), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (l == MAP_FAILED) {
+        perror("mmap lote");
+        return -1;
+    }
+
+    int resultado = directorio_salida != NULL ? leer_directorio(l, fuente, directorio_salida)
+                                              : leer_lista(l, fuente);
+    uint64_t inicio = ahora_ns();
+    if (resultado == 0) {
+        if (n_trabajadores == 0) {
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            n_trabajadores = cpus < 1 ? 1 : cpus > MAX_TRABAJADORES ? MAX_TRABAJADORES : (int) cpus;
+        }
+        if ((size_t) n_trabajadores > l->n)
+            n_trabajadores = l->n > 0 ? (int) l->n : 1;
+        if (lanzar_trabajadores(n_trabajadores, trabajar_lote, l) < 0 || l->errores > 0)
+            resultado = -1;
+    }
+    double segundos = (double) (ahora_ns() - inicio) / 1e9;
+
+    if (l->n > 0)
+        printf("Lote completado: %zu archivos, %zu errores, %.3f s (%.0f archivos/s)\n", l->n, l->errores,
+               segundos, segundos > 0 ? (double) l->n / segundos : 0.0);
+    // con varios trabajadores es tiempo sumado, no transcurrido
+    if (l->n > 0)
+        informar_durabilidad(l->ns_durabilidad);
+    for (size_t i = 0; i < l->n; i++) {
+        free(l->entradas[i]);
+        free(l->salidas[i]);
+    }
+    free(l->entradas);
+    free(l->salidas);
+    munmap(l, sizeof(struct lote));
+    return resultado;
+}
+
+// --- ÍNDICE DISPERSO (--indice, --consulta) ---
+// Como los dígitos se expanden, no hay forma de saber dónde cae un byte de la
+// entrada en la salida sin transformar todo lo anterior. Con --indice, kaio
+// apunta cada 'paso' bytes de entrada (--paso KiB, 64 por defecto) dónde
+// empieza ese bloque en la salida y cuántos asteriscos lleva acumulados, y lo
+// guarda en un archivo binario: una cabecera y una entrada por bloque.
+// Con --consulta se usa el índice para transformar solo lo necesario:
+//   kaio --consulta=indice.idx entrada X        offset de salida de X y asteriscos hasta X
+//   kaio --consulta=indice.idx entrada A B      bytes [A, B) de la salida, a stdout
+
+#define MAGIA_INDICE    "KAIOIDX1"
+#define PASO_INDICE     (64 * 1024)
+
+struct cabecera_indice {
+    char magia[8];
+    uint64_t paso;
+    uint64_t n_entradas;
+    uint64_t tamaño_entrada;
+    uint64_t tamaño_intermedio;     // salida sin footer
+    uint64_t asteriscos;
+    struct kaio_reglas reglas;
+};
+
+struct entrada_indice {
+    uint64_t offset_entrada;
+    uint64_t offset_salida;
+    uint64_t asteriscos;            // acumulados antes de offset_entrada
+};
+
+// Mide la entrada bloque a bloque; sustituye a kaio_medir cuando se pide
+// índice, así que no cuesta una pasada más
+static struct entrada_indice *medir_con_indice(const char *map_entrada, size_t tamaño_entrada, size_t paso,
+                                               size_t *n_entradas, size_t *tamaño_intermedio, uint64_t *asteriscos) {
+    size_t n = (tamaño_entrada + paso - 1) / paso;
+    struct entrada_indice *entradas = malloc((n ? n : 1) * sizeof(struct entrada_indice));
+    if (entradas == NULL) {
+        perror("malloc índice");
+        return NULL;
+    }
+    size_t tamaño = 0;
+    uint64_t total = 0;
+    for (size_t k = 0; k < n; k++) {
+        size_t offset = k * paso;
+        size_t longitud = tamaño_entrada - offset < paso ? tamaño_entrada - offset : paso;
+        entradas[k].offset_entrada = offset;
+        entradas[k].offset_salida = tamaño;
+        entradas[k].asteriscos = total;
+        tamaño += kaio_medir(map_entrada + offset, longitud, &total);
+    }
+    *n_entradas = n;
+    *tamaño_intermedio = tamaño;
+    *asteriscos = total;
+    return entradas;
+}
+
+static int escribir_indice(const char *archivo, size_t paso, const struct entrada_indice *entradas, size_t n,
+                           size_t tamaño_entrada, size_t tamaño_intermedio, uint64_t asteriscos) {
+    struct cabecera_indice cabecera;
+    memset(&cabecera, 0, sizeof(cabecera));
+    memcpy(cabecera.magia, MAGIA_INDICE, sizeof(cabecera.magia));
+    cabecera.paso = paso;
+    cabecera.n_entradas = n;
+    cabecera.tamaño_entrada = tamaño_entrada;
+    cabecera.tamaño_intermedio = tamaño_intermedio;
+    cabecera.asteriscos = asteriscos;
+    cabecera.reglas = *kaio_reglas_activas();
+
+    FILE *f = fopen(archivo, "wb");
+    if (f == NULL) {
+        perror("fopen índice");
+        return -1;
+    }
+    int error = fwrite(&cabecera, sizeof(cabecera), 1, f) != 1 ||
+                fwrite(entradas, sizeof(struct entrada_indice), n, f) != n;
+    if (fclose(f) != 0 || error) {
+        perror("fwrite índice");
+        return -1;
+    }
+    return 0;
+}
+
+// Carga el índice y comprueba que corresponde a esta entrada y a estas reglas
+static struct entrada_indice *leer_indice(const char *archivo, size_t tamaño_entrada,
+                                          struct cabecera_indice *cabecera) {
+    FILE *f = fopen(archivo, "rb");
+    if (f == NULL) {
+        perror("fopen índice");
+        return NULL;
+    }
+    const struct kaio_reglas *reglas = kaio_reglas_activas();
+    struct entrada_indice *entradas = NULL;
+    if (fread(cabecera, sizeof(*cabecera), 1, f) != 1 ||
+        memcmp(cabecera->magia, MAGIA_INDICE, sizeof(cabecera->magia)) != 0 || cabecera->paso == 0 ||
+        cabecera->n_entradas != (cabecera->tamaño_entrada + cabecera->paso - 1) / cabecera->paso) {
+        fprintf(stderr, "%s no es un índice de kaio.\n", archivo);
+    } else if (cabecera->tamaño_entrada != tamaño_entrada || cabecera->reglas.relleno != reglas->relleno ||
+               cabecera->reglas.letras != reglas->letras || cabecera->reglas.digitos != reglas->digitos) {
+        fprintf(stderr, "El índice no corresponde a esta entrada o a estas reglas.\n");
+    } else {
+        size_t n = (size_t) cabecera->n_entradas;
+        entradas = malloc((n ? n : 1) * sizeof(struct entrada_indice));
+        if (entradas == NULL) {
+            perror("malloc índice");
+        } else if (fread(entradas, sizeof(struct entrada_indice), n, f) != n) {
+            fprintf(stderr, "Índice truncado: %s\n", archivo);
+            free(entradas);
+            entradas = NULL;
+        }
+    }
+    fclose(f);
+    return entradas;
+}
+
+// Último bloque que empieza en la salida en 'offset' o antes
+static size_t buscar_bloque(const struct entrada_indice *entradas, size_t n, uint64_t offset) {
+    size_t bajo = 0, alto = n;
+    while (alto - bajo > 1) {
+        size_t medio = bajo + (alto - bajo) / 2;
+        if (entradas[medio].offset_salida <= offset)
+            bajo = medio;
+        else
+            alto = medio;
+    }
+    return bajo;
+}
+
+// Lee un número decimal sin signo; -1 si el texto no es solo eso (strtoull
+// aceptaría "abc" como 0, "12abc" como 12 y "-1" como el máximo)
+static int leer_numero(const char *texto, uint64_t *valor) {
+    if (*texto < '0' || *texto > '9')
+        return -1;
+    char *fin;
+    errno = 0;
+    unsigned long long n = strtoull(texto, &fin, 10);
+    if (*fin != '\0' || errno == ERANGE)
+        return -1;
+    *valor = n;
+    return 0;
+}
+
+static int consultar_indice(const char *archivo_indice, const char *entradafile, const char *desde, const char *hasta) {
     int descriptor_entrada = open(entradafile, O_RDONLY);
     if (descriptor_entrada < 0) {
         perror("open entrada");
-        return 1;
+        return -1;
     }
-
-    struct stat stat_entrada;
-    if (fstat(descriptor_entrada, &stat_entrada) < 0) {
+    struct stat st;
+    if (fstat(descriptor_entrada, &st) < 0) {
         perror("fstat entrada");
         close(descriptor_entrada);
-        return 1;
+        return -1;
     }
+    size_t tamaño_entrada = (size_t) st.st_size;
 
-    size_t tamaño_entrada = (size_t) stat_entrada.st_size;
+    uint64_t numero_desde, numero_hasta = 0;
+    const char *invalido = leer_numero(desde, &numero_desde) < 0 ? desde
+                         : hasta != NULL && leer_numero(hasta, &numero_hasta) < 0 ? hasta : NULL;
+    if (invalido != NULL) {
+        fprintf(stderr, "Offset inválido: %s\n", invalido);
+        close(descriptor_entrada);
+        return -1;
+    }
 
-    // mapear archivo de entrada (solo lectura)
-    char *map_entrada = mmap(NULL, tamaño_entrada, PROT_READ, MAP_PRIVATE, descriptor_entrada, 0);
-    if (map_entrada == MAP_FAILED) {
-        perror("mmap entrada");
+    struct cabecera_indice cabecera;
+    struct entrada_indice *entradas = leer_indice(archivo_indice, tamaño_entrada, &cabecera);
+    if (entradas == NULL) {
         close(descriptor_entrada);
-        return 1;
+        return -1;
     }
-    close(descriptor_entrada);
+    size_t n = (size_t) cabecera.n_entradas;
+    size_t paso = (size_t) cabecera.paso;
+    size_t pagina = (size_t) sysconf(_SC_PAGESIZE);
+    int resultado = 0;
 
-    // calcular tamaño intermedio
-    size_t tamaño_intermedio = 0;
-    for (size_t i = 0; i < tamaño_entrada; i++) {
-        unsigned char caracter_atual = (unsigned char) map_entrada[i];
-        if (isdigit(caracter_atual)) { // caracter atual es un número
-            int digitos = caracter_atual - '0';
-            tamaño_intermedio += (size_t)digitos;
+    if (hasta == NULL) {
+        // posición de un byte de entrada: se mide desde el inicio de su bloque
+        uint64_t x = numero_desde;
+        if (x > tamaño_entrada) {
+            fprintf(stderr, "El offset %" PRIu64 " está fuera de la entrada.\n", x);
+            resultado = -1;
+        } else if (x == tamaño_entrada) {
+            printf("%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", x, cabecera.tamaño_intermedio, cabecera.asteriscos);
         } else {
-            tamaño_intermedio += 1;
+            const struct entrada_indice *e = &entradas[x / paso];
+            size_t inicio = (size_t) e->offset_entrada / pagina * pagina;
+            size_t longitud = (size_t)(x - inicio);
+            uint64_t asteriscos = e->asteriscos;
+            size_t offset_salida = (size_t) e->offset_salida;
+            if (longitud > 0) {
+                char *map = proyectar_entrada(descriptor_entrada, longitud, inicio);
+                if (map == MAP_FAILED) {
+                    perror("mmap entrada");
+                    resultado = -1;
+                } else {
+                    size_t desfase = (size_t) e->offset_entrada - inicio;
+                    offset_salida += kaio_medir(map + desfase, longitud - desfase, &asteriscos);
+                    munmap(map, longitud);
+                }
+            }
+            if (resultado == 0)
+                printf("%" PRIu64 ",%zu,%" PRIu64 "\n", x, offset_salida, asteriscos);
         }
+        free(entradas);
+        close(descriptor_entrada);
+        return resultado;
     }
 
-    // buffer temporal compartido (no es el archivo)
-    char *buffer_compartido = mmap(NULL, tamaño_intermedio, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);   
-    if (buffer_compartido == MAP_FAILED) {
-        perror("mmap buffer_compartido");
-        munmap(map_entrada, tamaño_entrada);
-        return 1;
+    // rango de salida [a, b): se transforman solo los bloques que lo tocan,
+    // de uno en uno, y el footer sale del total guardado en la cabecera
+    char footer[KAIO_MAX_FOOTER];
+    size_t tamaño_intermedio = (size_t) cabecera.tamaño_intermedio;
+    size_t tamaño_final = tamaño_intermedio + (size_t) kaio_footer(footer, cabecera.asteriscos);
+    size_t a = (size_t) numero_desde;
+    size_t b = (size_t) numero_hasta;
+    if (b > tamaño_final)
+        b = tamaño_final;
+    char *buffer = malloc(KAIO_MAX_SALIDA(paso));
+    if (buffer == NULL) {
+        perror("malloc");
+        free(entradas);
+        close(descriptor_entrada);
+        return -1;
     }
 
-    // crear archivo de salida con tamaño tamaño_intermedio
-    int descriptor_salida = open(salidafile, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    for (size_t k = n > 0 && a < tamaño_intermedio ? buscar_bloque(entradas, n, a) : n;
+         resultado == 0 && k < n && entradas[k].offset_salida < b; k++) {
+        size_t offset = (size_t) entradas[k].offset_entrada;
+        size_t longitud = tamaño_entrada - offset < paso ? tamaño_entrada - offset : paso;
+        size_t inicio = offset / pagina * pagina;
+        char *map = proyectar_entrada(descriptor_entrada, offset - inicio + longitud, inicio);
+        if (map == MAP_FAILED) {
+            perror("mmap entrada");
+            resultado = -1;
+            break;
+        }
+        size_t escritos = kaio_transformar(map + (offset - inicio), longitud, buffer);
+        munmap(map, offset - inicio + longitud);
+
+        // parte del bloque que cae dentro de [a, b)
+        size_t base = (size_t) entradas[k].offset_salida;
+        size_t primero = a > base ? a - base : 0;
+        size_t ultimo = b - base < escritos ? b - base : escritos;
+        if (primero < ultimo && escribir_todo(STDOUT_FILENO, buffer + primero, ultimo - primero) < 0)
+            resultado = -1;
+    }
+    if (resultado == 0 && b > tamaño_intermedio) {
+        size_t primero = a > tamaño_intermedio ? a - tamaño_intermedio : 0;
+        if (primero < b - tamaño_intermedio &&
+            escribir_todo(STDOUT_FILENO, footer + primero, b - tamaño_intermedio - primero) < 0)
+            resultado = -1;
+    }
+    free(buffer);
+    free(entradas);
+    close(descriptor_entrada);
+    return resultado;
+}
+
+// --- SALIDA RLE (--formato=rle, --decodificar) ---
+// La salida se escribe con el formato RLE de libkaio (ver libkaio.h): las
+// rachas de asteriscos ocupan dos bytes en lugar de hasta nueve por dígito.
+// Como el tamaño RLE no se conoce sin codificar, la salida se escribe de
+// forma secuencial por trozos en lugar de proyectarla. --decodificar hace el
+// camino inverso y deja exactamente la salida normal, con su footer.
+
+#define TAM_TROZO_RLE   (1 << 20)
+
+static int procesar_rle(int descriptor_entrada, size_t tamaño_entrada, const char *salidafile) {
+    char *map_entrada = NULL;
+    if (tamaño_entrada > 0) {
+        map_entrada = proyectar_entrada(descriptor_entrada, tamaño_entrada, 0);
+        if (map_entrada == MAP_FAILED) {
+            perror("mmap entrada");
+            return -1;
+        }
+        madvise(map_entrada, tamaño_entrada, MADV_SEQUENTIAL);
+    }
+    char *buffer = malloc(KAIO_MAX_RLE(TAM_TROZO_RLE));
+    int descriptor_salida = buffer != NULL ? crear_salida(salidafile, 0) : -1;
     if (descriptor_salida < 0) {
-        perror("open salida");
-        munmap(buffer_compartido, tamaño_intermedio);
-        munmap(map_entrada, tamaño_entrada);
-        return 1;
+        if (buffer == NULL)
+            perror("malloc");
+        free(buffer);
+        if (map_entrada != NULL)
+            munmap(map_entrada, tamaño_entrada);
+        return -1;
     }
 
-    // espacio extra al final para variable de sincronización (int)
-    size_t tamaño_total_map = tamaño_intermedio + sizeof(int);
+    struct kaio_rle rle;
+    kaio_rle_iniciar(&rle);
+    int resultado = 0;
+    for (size_t i = 0; resultado == 0 && i < tamaño_entrada; i += TAM_TROZO_RLE) {
+        size_t longitud = tamaño_entrada - i < TAM_TROZO_RLE ? tamaño_entrada - i : TAM_TROZO_RLE;
+        size_t escritos = kaio_rle_procesar(&rle, map_entrada + i, longitud, buffer);
+        resultado = escribir_todo(descriptor_salida, buffer, escritos);
+    }
+    if (resultado == 0)
+        resultado = escribir_todo(descriptor_salida, buffer, kaio_rle_terminar(&rle, buffer));
+    if (resultado == 0)
+        printf("RLE: %" PRIu64 " bytes en lugar de %" PRIu64 "\n", rle.estado.bytes_salida, rle.bytes_normales);
+    if (resultado == 0)
+        resultado = aplicar_durabilidad(descriptor_salida, salidafile);
 
-    // Asignar tamaño al archivo físico de salida
-    if (ftruncate(descriptor_salida, tamaño_total_map) == -1) {
-        perror("ftruncate salida");
-        munmap(buffer_compartido, tamaño_intermedio);
+    free(buffer);
+    close(descriptor_salida);
+    if (map_entrada != NULL)
         munmap(map_entrada, tamaño_entrada);
-        close(descriptor_salida);
-        return 1;
+    return resultado;
+}
+
+static int decodificar_rle(const char *entradafile, const char *salidafile) {
+    int descriptor_entrada = open(entradafile, O_RDONLY);
+    if (descriptor_entrada < 0) {
+        perror("open entrada");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(descriptor_entrada, &st) < 0) {
+        perror("fstat entrada");
+        close(descriptor_entrada);
+        return -1;
+    }
+    size_t tamaño_rle = (size_t) st.st_size;
+    char *map_rle = tamaño_rle > 0 ? proyectar_entrada(descriptor_entrada, tamaño_rle, 0) : MAP_FAILED;
+    close(descriptor_entrada);
+    size_t tamaño = map_rle != MAP_FAILED ? kaio_rle_tamaño(map_rle, tamaño_rle) : (size_t)-1;
+    if (tamaño == (size_t)-1) {
+        fprintf(stderr, "%s no está en formato RLE de kaio.\n", entradafile);
+        if (map_rle != MAP_FAILED)
+            munmap(map_rle, tamaño_rle);
+        return -1;
     }
 
-    // Proyectar archivo de salida en memoria (COMPARTIDO para lectura/escritura)
-    char *map_salida = mmap(NULL, tamaño_total_map, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor_salida, 0);
-    if (map_salida == MAP_FAILED) {
-        perror("mmap salida");
-        munmap(buffer_compartido, tamaño_intermedio);
-      munmap(map_entrada, tamaño_entrada);
+    int resultado = -1;
+    int descriptor_salida = crear_salida(salidafile, tamaño);
+    if (descriptor_salida >= 0) {
+        char *map_salida = proyectar_salida(descriptor_salida, tamaño, 0);
+        if (map_salida == MAP_FAILED) {
+            perror("mmap salida");
+        } else {
+            kaio_rle_decodificar(map_rle, tamaño_rle, map_salida);
+            munmap(map_salida, tamaño);
+            resultado = aplicar_durabilidad(descriptor_salida, salidafile);
+        }
         close(descriptor_salida);
+    }
+    munmap(map_rle, tamaño_rle);
+    return resultado;
+}
+
+static void uso(const char *programa) {
+    fprintf(stderr, "Uso correcto: %s [-j N | -m MiB | -t traza.csv | --io=mmap|uring|directo | --incremental]\n"
+                    "       [--stats[=archivo.csv]] [--huge=no|thp|hugetlb] [--prefault] [--hilos]\n"
+                    "       [--indice=archivo.idx [--paso=KiB] | --formato=normal|rle] <archivo_entrada> <archivo_salida>\n"
+                    "       %s --consulta=archivo.idx <archivo_entrada> <offset> | <desde> <hasta>\n"
+                    "       %s --decodificar <archivo_rle> <archivo_salida>\n"
+                    "       %s [-j N] [--hilos] --batch lista.txt | --batch dir_entrada dir_salida\n"
+                    "Reglas (cualquier modo): [--reglas=asteriscos|subrayado|minusculas|mayusculas|digitos]\n"
+                    "       [--relleno=C] [--letras=mayusculas|minusculas|igual] [--digitos=expandir|igual]\n"
+                    "Durabilidad de la salida (cualquier modo): [--durability=none|async|data|full]\n"
+                    "       (por defecto data con mmap, -j, -m, --io=uring e --incremental; none en el resto)\n",
+            programa, programa, programa, programa);
+}
+
+int main (int argc, char *argv[]) {
+
+    int n_trabajadores = 0;     // 0: modo clásico padre/hijo
+    size_t memoria_maxima = 0;  // 0: sin límite (proyecciones completas)
+    const char *archivo_traza = NULL;
+    int usar_uring = 0;
+    int usar_directo = 0;
+    int con_estadisticas = 0;
+    int incremental = 0;
+    const char *archivo_indice = NULL;     // --indice: se escribe junto con la salida
+    const char *indice_consulta = NULL;    // --consulta: solo se lee
+    size_t paso_indice = PASO_INDICE;
+    uint64_t paso = 0;      // --paso en KiB; 0: no se ha dado
+    uint64_t mib;           // -m
+    uint64_t trabajadores;  // -j
+    int formato_rle = 0;
+    int decodificar = 0;
+    const char *fuente_lote = NULL;     // --batch: lista de pares o directorio
+    const char *archivo_estadisticas = NULL;   // NULL: a stderr
+    const char *nombre_reglas = NULL;   // --reglas: conjunto de partida
+    int relleno = -1, letras = -1, digitos = -1;   // -1: el del conjunto
+    static const struct option opciones_largas[] = {
+        { "io", required_argument, NULL, 'i' },
+        { "stats", optional_argument, NULL, 's' },
+        { "huge", required_argument, NULL, 'h' },
+        { "prefault", no_argument, NULL, 'p' },
+        { "hilos", no_argument, NULL, 'H' },
+        { "batch", required_argument, NULL, 'b' },
+        { "reglas", required_argument, NULL, 'R' },
+        { "relleno", required_argument, NULL, 'F' },
+        { "letras", required_argument, NULL, 'L' },
+        { "digitos", required_argument, NULL, 'D' },
+        { "incremental", no_argument, NULL, 'I' },
+        { "indice", required_argument, NULL, 'X' },
+        { "paso", required_argument, NULL, 'P' },
+        { "consulta", required_argument, NULL, 'Q' },
+        { "formato", required_argument, NULL, 'f' },
+        { "decodificar", no_argument, NULL, 'd' },
+        { "durability", required_argument, NULL, 'y' },
+        { NULL, 0, NULL, 0 }
+    };
+    int opcion;
+    while ((opcion = getopt_long(argc, argv, "j:m:t:", opciones_largas, NULL)) != -1) {
+        switch (opcion) {
+        case 'j':
+            if (leer_numero(optarg, &trabajadores) < 0 || trabajadores < 1 || trabajadores > MAX_TRABAJADORES) {
+                fprintf(stderr, "El número de trabajadores debe estar entre 1 y %d.\n", MAX_TRABAJADORES);
+                return 1;
+            }
+            n_trabajadores = (int) trabajadores;
+            break;
+        case 'm':
+            if (leer_numero(optarg, &mib) < 0 || mib == 0 || mib > SIZE_MAX >> 20) {
+                fprintf(stderr, "La memoria máxima se indica en MiB y debe estar entre 1 y %zu.\n", (size_t) SIZE_MAX >> 20);
+                return 1;
+            }
+            memoria_maxima = (size_t) mib << 20;
+            break;
+        case 't':
+            archivo_traza = optarg;
+            break;
+        case 'i':
+            if (strcmp(optarg, "uring") == 0) {
+                usar_uring = 1;
+            } else if (strcmp(optarg, "directo") == 0) {
+                usar_directo = 1;
+            } else if (strcmp(optarg, "mmap") != 0) {
+                uso(argv[0]);
+                return 1;
+            }
+            break;
+        case 's':
+            con_estadisticas = 1;
+            archivo_estadisticas = optarg;
+            break;
+        case 'h':
+            if (strcmp(optarg, "thp") == 0) {
+                paginas_grandes = PAGINAS_THP;
+            } else if (strcmp(optarg, "hugetlb") == 0) {
+                paginas_grandes = PAGINAS_HUGETLB;
+            } else if (strcmp(optarg, "no") != 0) {
+                uso(argv[0]);
+                return 1;
+            }
+            break;
+        case 'p':
+            prefaltar = 1;
+            break;
+        case 'H':
+            usar_hilos = 1;
+            break;
+        case 'b':
+            fuente_lote = optarg;
+            break;
+        case 'I':
+            incremental = 1;
+            break;
+        case 'X':
+            archivo_indice = optarg;
+            break;
+        case 'P':
+            if (leer_numero(optarg, &paso) < 0 || paso == 0 || paso > SIZE_MAX >> 10) {
+                fprintf(stderr, "El paso del índice se indica en KiB y debe ser mayor que 0.\n");
+                return 1;
+            }
+            paso_indice = (size_t) paso << 10;
+            break;
+        case 'Q':
+            indice_consulta = optarg;
+            break;
+        case 'f':
+            if (strcmp(optarg, "rle") == 0) {
+                formato_rle = 1;
+            } else if (strcmp(optarg, "normal") != 0) {
+                uso(argv[0]);
+                return 1;
+            }
+            break;
+        case 'd':
+            decodificar = 1;
+            break;
+        case 'y':
+            for (durabilidad = DURABILIDAD_FULL; durabilidad >= 0; durabilidad--)
+                if (strcmp(optarg, nombres_durabilidad[durabilidad]) == 0)
+                    break;
+            if (durabilidad < 0) {
+                uso(argv[0]);
+                return 1;
+            }
+            break;
+        case 'R':
+            nombre_reglas = optarg;
+            break;
+        case 'F':
+            if (strlen(optarg) != 1) {
+                fprintf(stderr, "El relleno debe ser un único carácter.\n");
+                return 1;
+            }
+            relleno = (unsigned char) optarg[0];
+            break;
+        case 'L':
+            if (strcmp(optarg, "mayusculas") == 0) {
+                letras = KAIO_LETRAS_MAYUSCULAS;
+            } else if (strcmp(optarg, "minusculas") == 0) {
+                letras = KAIO_LETRAS_MINUSCULAS;
+            } else if (strcmp(optarg, "igual") == 0) {
+                letras = KAIO_LETRAS_IGUAL;
+            } else {
+                uso(argv[0]);
+                return 1;
+            }
+            break;
+        case 'D':
+            if (strcmp(optarg, "expandir") == 0) {
+                digitos = KAIO_DIGITOS_EXPANDIR;
+            } else if (strcmp(optarg, "igual") == 0) {
+                digitos = KAIO_DIGITOS_IGUAL;
+            } else {
+                uso(argv[0]);
+                return 1;
+            }
+            break;
+        default:
+            uso(argv[0]);
+            return 1;
+        }
+    }
+
+    // las reglas se fijan antes de crear procesos o hilos, que las heredan
+    if (nombre_reglas != NULL || relleno >= 0 || letras >= 0 || digitos >= 0) {
+        const struct kaio_reglas *base = kaio_buscar_reglas(nombre_reglas != NULL ? nombre_reglas : "asteriscos");
+        if (base == NULL) {
+            fprintf(stderr, "Reglas desconocidas: %s\n", nombre_reglas);
+            return 1;
+        }
+        struct kaio_reglas reglas = *base;
+        if (relleno >= 0)
+            reglas.relleno = (unsigned char) relleno;
+        if (letras >= 0)
+            reglas.letras = letras;
+        if (digitos >= 0)
+            reglas.digitos = digitos;
+        if (kaio_usar_reglas(&reglas) < 0) {
+            uso(argv[0]);
+            return 1;
+        }
+    }
+
+    if (paso > 0 && archivo_indice == NULL) {
+        fprintf(stderr, "--paso solo se puede usar con --indice.\n");
         return 1;
     }
-    close(descriptor_salida); // Ya no necesitamos el descriptor
 
-    // Puntero a la bandera de sincronización (situada al final del archivo temporalmente)
-    volatile int *sync_flag = (int *)(map_salida + tamaño_intermedio);
-    *sync_flag = 0; // 0: Inicio, 1: Mitad lista, 2: Todo listo
+    // -j, -m, -t (traza del modo padre/hijo), --io=uring|directo, --incremental, --formato=rle y
+    // --decodificar son modos excluyentes
+    // modo lote: -j es el tamaño del grupo de trabajadores
+    if (fuente_lote != NULL) {
+        struct stat st;
+        int es_directorio = stat(fuente_lote, &st) == 0 && S_ISDIR(st.st_mode);
+        if (argc - optind != es_directorio || memoria_maxima > 0 || archivo_traza != NULL || usar_uring || incremental ||
+            usar_directo || formato_rle || decodificar ||
+            con_estadisticas) {
+            uso(argv[0]);
+            return 1;
+        }
+        elegir_durabilidad(0);
+        return procesar_lote(fuente_lote, es_directorio ? argv[optind] : NULL, n_trabajadores) < 0 ? 1 : 0;
+    }
 
-    // punto medio del archivo de ENTRADA
-    size_t mitad_entrada = tamaño_entrada / 2;
+    // consulta del índice: no se escribe ninguna salida
+    if (indice_consulta != NULL) {
+        if (argc - optind < 2 || argc - optind > 3 || n_trabajadores > 0 || memoria_maxima > 0 ||
+            archivo_traza != NULL || usar_uring || usar_directo || incremental || con_estadisticas ||
+            archivo_indice != NULL ||
+            formato_rle || decodificar) {
+            uso(argv[0]);
+            return 1;
+        }
+        return consultar_indice(indice_consulta, argv[optind], argv[optind + 1],
+                                argc - optind == 3 ? argv[optind + 2] : NULL) < 0 ? 1 : 0;
+    }
 
-    // Crear proceso hijo
-    pid_t pid = fork();
-    if (pid < 0) {
-        perror("fork");
-        munmap(buffer_compartido, tamaño_intermedio);
-        munmap(map_entrada, tamaño_entrada);
-        munmap(map_salida, tamaño_total_map);
+    int modos = (n_trabajadores > 0) + (memoria_maxima > 0) + (archivo_traza != NULL) + usar_uring + usar_directo +
+                incremental +
+                formato_rle + decodificar;
+    if (argc - optind != 2 || modos > 1) {
+        uso(argv[0]);
         return 1;
-    } else if (pid == 0) {
-        // --- PROCESO HIJO (Maneja los NÚMEROS -> ASTERISCOS) ---
+    }
 
-        // Esperar a que el padre procese la primera mitad
-        while (*sync_flag < 1) usleep(1000);
+    // las fases medidas son las de los modos con proyección completa
+    if (con_estadisticas && (memoria_maxima > 0 || usar_uring || usar_directo || incremental || formato_rle ||
+                             decodificar)) {
+        fprintf(stderr, "--stats no se puede usar con -m, --io, --incremental, --formato=rle ni --decodificar.\n");
+        return 1;
+    }
 
-        size_t pos_salida = 0;
+    // el índice sale de la medición de la entrada proyectada entera
+    if (archivo_indice != NULL && (memoria_maxima > 0 || usar_uring || usar_directo || incremental || formato_rle ||
+                                   decodificar)) {
+        fprintf(stderr, "--indice no se puede usar con -m, --io, --incremental, --formato=rle ni --decodificar.\n");
+        return 1;
+    }
 
-        // Recorremos todo el archivo, pero solo actuamos si encontramos números
-        for (size_t i = 0; i < tamaño_entrada; i++) {
+    char *entradafile = argv[optind];
+    char *salidafile = argv[optind + 1];
 
-            // Pausa de sincronización al llegar a la segunda mitad
-            if (i == mitad_entrada)
-                while (*sync_flag < 2) usleep(1000); // Esperar a que padre termine todo
+    int entrada_estandar = strcmp(entradafile, "-") == 0;
+    int salida_estandar = strcmp(salidafile, "-") == 0;
+    elegir_durabilidad(!entrada_estandar && !salida_estandar && !formato_rle && !decodificar && !usar_directo);
 
-            unsigned char c = (unsigned char) map_entrada[i];
+    // comprueba los nombres de archivo diferentes ("- -" es stdin y stdout)
+    if (strcmp(entradafile, salidafile) == 0 && !entrada_estandar) {
+        fprintf(stderr, "El archivo de salida debe ser diferente al de entrada.\n");
+        return 1;
+    }
 
-            if (isdigit(c)) {
-                int num_asteriscos = c - '0';
-                // Escribimos '*' repetidamente en el buffer temporal
-                memset(buffer_compartido + pos_salida, '*', num_asteriscos);
-                pos_salida += num_asteriscos;
-            }
-            else if (isalpha(c)) {
-                // El padre ya escribió (o escribirá), solo avanzamos
-                pos_salida += 1;
-            }
-            else {
-                pos_salida += 1;
-            }
+    // modo tubería: '-' es la entrada o la salida estándar
+    if (entrada_estandar || salida_estandar) {
+        if (modos > 0 || con_estadisticas || archivo_indice != NULL) {
+            fprintf(stderr, "Las opciones -j, -m, -t, --io, --incremental, --indice, --formato, --decodificar y\n"
+                            "--stats no se pueden usar con '-'.\n");
+            return 1;
         }
+        if (procesar_tuberia(entradafile, salidafile) < 0)
+            return 1;
+        // con la salida estándar el mensaje final ensuciaría los datos
+        if (!salida_estandar)
+            printf("Proceso completado. Archivo generado: %s\n", salidafile);
+        return 0;
+    }
 
-        // hijo termina; limpia sus mappings
-        munmap(map_entrada, tamaño_entrada);
-        munmap(buffer_compartido, tamaño_intermedio);
-        munmap(map_salida, tamaño_total_map);
-        exit(0);
-    } else {
-        // --- PROCESO PADRE (Maneja LETRAS -> MAYÚSCULAS) ---
+    if (decodificar) {
+        if (decodificar_rle(entradafile, salidafile) < 0)
+            return 1;
+        printf("Proceso completado. Archivo generado: %s\n", salidafile);
+        return 0;
+    }
 
-        size_t pos_salida = 0;
+    // abrir entrada archivo y obtener tamaño
+    int descriptor_entrada = open(entradafile, O_RDONLY);
+    if (descriptor_entrada < 0) {
+        perror("open entrada");
+        return 1;
+    }
 
-        for (size_t i = 0; i < tamaño_entrada; i++) {
+    struct stat stat_entrada;
+    if (fstat(descriptor_entrada, &stat_entrada) < 0) {
+        perror("fstat entrada");
+        close(descriptor_entrada);
+        return 1;
+    }
 
-            // Si llegamos a la mitad, avisamos al hijo
-            if (i == mitad_entrada) {
-                *sync_flag = 1; // primera mitad lista
-                msync(map_salida, tamaño_total_map, MS_SYNC);
-            }
+    size_t tamaño_entrada = (size_t) stat_entrada.st_size;
 
-            unsigned char c = (unsigned char) map_entrada[i];
+    // modo de memoria acotada: ventanas deslizantes sobre entrada y salida
+    if (memoria_maxima > 0) {
+        int resultado = procesar_por_ventanas(descriptor_entrada, tamaño_entrada, salidafile, memoria_maxima);
+        close(descriptor_entrada);
+        if (resultado < 0)
+            return 1;
+        printf("Proceso completado. Archivo generado: %s\n", salidafile);
+        return 0;
+    }
 
-            if (isalpha(c)) {
-                buffer_compartido[pos_salida] = toupper(c);
-                pos_salida += 1;
-            }
-            else if (isdigit(c)) {
-                int num_asteriscos = c - '0';
-                pos_salida += num_asteriscos; // sólo reservamos hueco
-            }
-            else {
-                buffer_compartido[pos_salida] = (char) c;
-                pos_salida += 1;
-            }
-        }
+    // salida RLE: secuencial, sin proyectar la salida
+    if (formato_rle) {
+        int resultado = procesar_rle(descriptor_entrada, tamaño_entrada, salidafile);
+        close(descriptor_entrada);
+        if (resultado < 0)
+            return 1;
+        printf("Proceso completado. Archivo generado: %s\n", salidafile);
+        return 0;
+    }
 
-        // Fin del procesamiento del padre
-        *sync_flag = 2; // todo listo
-        msync(map_salida, tamaño_total_map, MS_SYNC);
+    // modo incremental: solo lo añadido desde la última ejecución
+    if (incremental) {
+        int resultado = procesar_incremental(descriptor_entrada, tamaño_entrada, salidafile);
+        close(descriptor_entrada);
+        if (resultado < 0)
+            return 1;
+        printf("Proceso completado. Archivo generado: %s\n", salidafile);
+        return 0;
+    }
 
-        // Esperar a que el hijo termine
-        wait(NULL);
+    // salida sin caché: lectura por trozos y escritura con O_DIRECT
+    if (usar_directo) {
+        int resultado = procesar_directo(descriptor_entrada, tamaño_entrada, salidafile);
+        close(descriptor_entrada);
+        if (resultado < 0)
+            return 1;
+        printf("Proceso completado. Archivo generado: %s\n", salidafile);
+        return 0;
+    }
 
-        // 4. FASE FINAL: Recuento de asteriscos en buffer_compartido
-        int total_asteriscos = 0;
-        for (size_t k = 0; k < tamaño_intermedio; k++) {
-            if (buffer_compartido[k] == '*') {
-                total_asteriscos++;
-            }
+    // backend io_uring; si el kernel no lo ofrece seguimos con mmap
+    if (usar_uring) {
+        int resultado = procesar_uring(descriptor_entrada, tamaño_entrada, salidafile);
+        if (resultado <= 0) {
+            close(descriptor_entrada);
+            if (resultado < 0)
+                return 1;
+            printf("Proceso completado. Archivo generado: %s\n", salidafile);
+            return 0;
         }
+    }
 
-        // Preparamos el mensaje final
-        char buffer_contador_asteriscos[64];
-        int tam_contador = sprintf(buffer_contador_asteriscos,
-                                   "\nTotal asteriscos: %d\n",
-                                   total_asteriscos);
+    if (con_estadisticas && activar_estadisticas() < 0) {
+        close(descriptor_entrada);
+        return 1;
+    }
+    struct marca marca;
 
-        size_t tamaño_final = tamaño_intermedio + (size_t)tam_contador;
+    // mapear archivo de entrada (solo lectura)
+    empezar_fase(&marca);
+    char *map_entrada = proyectar_entrada(descriptor_entrada, tamaño_entrada, 0);
+    if (map_entrada == MAP_FAILED) {
+        perror("mmap entrada");
+        close(descriptor_entrada);
+        return 1;
+    }
+    close(descriptor_entrada);
+    terminar_fase(FASE_MMAP_ENTRADA, &marca);
 
-        // Desmapeamos mapa de entrada y salida "antiguo"
+    // en modo paralelo, tabla compartida con la medición de cada trozo
+    struct trozos trozos = { 0 };
+    if (n_trabajadores > 0 && preparar_trozos(&trozos, map_entrada, tamaño_entrada, n_trabajadores) < 0) {
         munmap(map_entrada, tamaño_entrada);
-        munmap(map_salida, tamaño_total_map);
+        return 1;
+    }
 
-        // Redimensionar archivo de salida al tamaño final
-        descriptor_salida = open(salidafile, O_RDWR);
-        if (descriptor_salida < 0) {
-            perror("open salida final");
-            munmap(buffer_compartido, tamaño_intermedio);
+    // calcular tamaño intermedio; el total de asteriscos sale de la misma pasada
+    size_t tamaño_intermedio;
+    uint64_t total_asteriscos = 0;
+    struct entrada_indice *indice = NULL;
+    size_t n_entradas_indice = 0;
+    empezar_fase(&marca);
+    if (archivo_indice != NULL) {
+        // con -j los trozos no coinciden con los bloques del índice: una
+        // pasada secuencial más
+        indice = medir_con_indice(map_entrada, tamaño_entrada, paso_indice, &n_entradas_indice,
+                                  &tamaño_intermedio, &total_asteriscos);
+        if (indice == NULL) {
+            if (n_trabajadores > 0)
+                liberar_trozos(&trozos);
+            munmap(map_entrada, tamaño_entrada);
             return 1;
         }
-        if (ftruncate(descriptor_salida, tamaño_final) == -1) {
-            perror("ftruncate salida final");
-            munmap(buffer_compartido, tamaño_intermedio);
-            close(descriptor_salida);
+    }
+    if (n_trabajadores > 0) {
+        total_asteriscos = 0;
+        tamaño_intermedio = medir_paralelo(&trozos, &total_asteriscos);
+        if (tamaño_intermedio == (size_t)-1) {
+            fprintf(stderr, "Error en la medición paralela.\n");
+            liberar_trozos(&trozos);
+            munmap(map_entrada, tamaño_entrada);
             return 1;
         }
+    } else if (indice == NULL) {
+        tamaño_intermedio = kaio_medir(map_entrada, tamaño_entrada, &total_asteriscos);
+    }
+    terminar_fase(FASE_MEDICION, &marca);
 
-        // Nueva proyección del archivo final
-        map_salida = mmap(NULL, tamaño_final,
-                          PROT_WRITE | PROT_READ,
-                          MAP_SHARED, descriptor_salida, 0);
-        if (map_salida == MAP_FAILED) {
-            perror("mmap salida final");
-            munmap(buffer_compartido, tamaño_intermedio);
-            close(descriptor_salida);
-            return 1;
-        }
+    // Preparamos el mensaje final: ya se conoce antes de transformar nada
+    empezar_fase(&marca);
+    char buffer_contador_asteriscos[KAIO_MAX_FOOTER];
+    int tam_contador = kaio_footer(buffer_contador_asteriscos, total_asteriscos);
+    terminar_fase(FASE_FOOTER, &marca);
+
+    size_t tamaño_final = tamaño_intermedio + (size_t)tam_contador;
+
+    // crear archivo de salida con su tamaño final (una sola vez)
+    empezar_fase(&marca);
+    int descriptor_salida = crear_salida(salidafile, tamaño_final);
+    if (descriptor_salida < 0) {
+        if (n_trabajadores > 0)
+            liberar_trozos(&trozos);
+        munmap(map_entrada, tamaño_entrada);
+        return 1;
+    }
+    terminar_fase(FASE_FTRUNCATE, &marca);
+
+    // Proyectar archivo de salida: los procesos escriben directamente en él
+    empezar_fase(&marca);
+    char *map_salida = proyectar_salida(descriptor_salida, tamaño_final, 0);
+    if (map_salida == MAP_FAILED) {
+        perror("mmap salida");
+        if (n_trabajadores > 0)
+            liberar_trozos(&trozos);
+        munmap(map_entrada, tamaño_entrada);
+        close(descriptor_salida);
+        return 1;
+    }
+    terminar_fase(FASE_MMAP_SALIDA, &marca);
+
+    int resultado;
+    empezar_fase(&marca);
+    if (n_trabajadores > 0) {
+        resultado = transformar_paralelo(&trozos, map_salida, tamaño_intermedio);
+        liberar_trozos(&trozos);
+    } else {
+        resultado = transformar_padre_hijo(map_entrada, tamaño_entrada, map_salida, archivo_traza);
+    }
+    terminar_fase(FASE_TRANSFORMACION, &marca);
 
-        // Copiamos el contenido del buffer temporal al archivo
-        memcpy(map_salida, buffer_compartido, tamaño_intermedio);
-        // Copiamos el footer al final
-        memcpy(map_salida + tamaño_intermedio,
-               buffer_contador_asteriscos,
-               (size_t)tam_contador);
+    // Ya no hace falta la entrada
+    munmap(map_entrada, tamaño_entrada);
 
-        msync(map_salida, tamaño_final, MS_SYNC);
+    if (resultado < 0) {
+        fprintf(stderr, "Error en la transformación.\n");
         munmap(map_salida, tamaño_final);
-        munmap(buffer_compartido, tamaño_intermedio);
         close(descriptor_salida);
+        return 1;
+    }
 
-        printf("Proceso completado. Archivo generado: %s\n", salidafile);
+    // Copiamos el footer al final
+    empezar_fase(&marca);
+    memcpy(map_salida + tamaño_intermedio,
+           buffer_contador_asteriscos,
+           (size_t)tam_contador);
+    terminar_fase(FASE_MEMCPY, &marca);
+
+    // las páginas sucias de la proyección siguen en la caché del archivo:
+    // la durabilidad se aplica sobre el descriptor, como en los demás modos
+    munmap(map_salida, tamaño_final);
+    empezar_fase(&marca);
+    resultado = aplicar_durabilidad(descriptor_salida, salidafile);
+    terminar_fase(FASE_DURABILIDAD, &marca);
+    close(descriptor_salida);
+    if (resultado < 0)
+        return 1;
+
+    if (indice != NULL) {
+        int error = escribir_indice(archivo_indice, paso_indice, indice, n_entradas_indice, tamaño_entrada,
+                                    tamaño_intermedio, total_asteriscos);
+        free(indice);
+        if (error < 0)
+            return 1;
     }
 
+    if (con_estadisticas && escribir_estadisticas(archivo_estadisticas) < 0)
+        return 1;
+
+    printf("Proceso completado. Archivo generado: %s\n", salidafile);
+
     return 0;
 }
@@ -0,0 +1,669 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>     // PRIu64
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>      // SSE2 / AVX2
+#endif
+
+#include "libkaio.h"
+
+// --- REGLAS Y KERNELS DE TRANSFORMACIÓN ---
+// Un conjunto de reglas (struct kaio_reglas) dice qué se hace con cada clase
+// de caracteres: las letras se dejan, pasan a mayúsculas o a minúsculas y los
+// dígitos se copian o se expanden en d bytes de relleno. Las clases son ASCII
+// (las mismas que isdigit/isalpha/toupper en el locale "C", que es el que usa
+// kaio): así los kernels escalar, SSE2 y AVX2 dan exactamente el mismo
+// resultado.
+//
+// Las reglas activas se compilan en tablas de 256 entradas, que es lo que
+// recorre el kernel escalar. Los kernels SSE2 y AVX2 se generan con
+// DEFINIR_KERNELS para cada conjunto de LISTA_REGLAS: las reglas son
+// constantes y el compilador quita lo que no hace falta. Un conjunto que no
+// está en la lista usa los mismos kernels con las reglas como variables.
+
+#define LISTA_REGLAS(X) \
+    X(asteriscos, '*', KAIO_LETRAS_MAYUSCULAS, KAIO_DIGITOS_EXPANDIR)   /* kaio */ \
+    X(subrayado,  '_', KAIO_LETRAS_MAYUSCULAS, KAIO_DIGITOS_EXPANDIR)   /* Entregable1 */ \
+    X(minusculas, '*', KAIO_LETRAS_MINUSCULAS, KAIO_DIGITOS_EXPANDIR) \
+    X(mayusculas, '*', KAIO_LETRAS_MAYUSCULAS, KAIO_DIGITOS_IGUAL) \
+    X(digitos,    '*', KAIO_LETRAS_IGUAL,      KAIO_DIGITOS_EXPANDIR)
+
+struct tabla_reglas {
+    unsigned char clase[256];       // modo que escribe el byte: KAIO_MODO_ASTERISCOS si se expande
+    unsigned char expansion[256];   // bytes de salida que genera (0..9)
+    unsigned char byte[256];        // byte que se repite 'expansion' veces
+    unsigned char rellenos[256];    // cuántos de ellos son de relleno (cuentan en el footer)
+};
+
+static struct kaio_reglas reglas_activas;
+static struct tabla_reglas tabla;
+
+static inline int es_digito(unsigned char c) {
+    return (unsigned char)(c - '0') < 10;
+}
+
+static inline int es_letra(unsigned char c) {
+    return (unsigned char)((c | 0x20) - 'a') < 26;
+}
+
+static inline unsigned char aplicar_letras(unsigned char c, int letras) {
+    if (letras == KAIO_LETRAS_MAYUSCULAS && (unsigned char)(c - 'a') < 26)
+        return (unsigned char)(c - ('a' - 'A'));
+    if (letras == KAIO_LETRAS_MINUSCULAS && (unsigned char)(c - 'A') < 26)
+        return (unsigned char)(c + ('a' - 'A'));
+    return c;
+}
+
+static void compilar_reglas(const struct kaio_reglas *reglas, struct tabla_reglas *t) {
+    for (unsigned c = 0; c < 256; c++) {
+        if (reglas->digitos == KAIO_DIGITOS_EXPANDIR && es_digito((unsigned char) c)) {
+            t->clase[c] = KAIO_MODO_ASTERISCOS;
+            t->expansion[c] = (unsigned char)(c - '0');
+            t->byte[c] = reglas->relleno;
+            t->rellenos[c] = t->expansion[c];
+        } else {
+            t->clase[c] = KAIO_MODO_TEXTO;
+            t->expansion[c] = 1;
+            t->byte[c] = aplicar_letras((unsigned char) c, reglas->letras);
+            t->rellenos[c] = t->byte[c] == reglas->relleno;
+        }
+    }
+}
+
+// Escribe exactamente d bytes de relleno (0 <= d <= 9) con dos escrituras
+// solapadas en lugar de un memset de longitud variable
+static inline __attribute__((always_inline))
+void escribir_relleno(char *destino, unsigned d, unsigned char relleno) {
+    uint64_t patron = 0x0101010101010101ULL * relleno;
+    if (d >= 4) {
+        size_t mitad = d >= 8 ? 8 : 4;
+        memcpy(destino, &patron, mitad);
+        memcpy(destino + d - mitad, &patron, mitad);
+    } else if (d >= 2) {
+        memcpy(destino, &patron, 2);
+        memcpy(destino + d - 2, &patron, 2);
+    } else if (d == 1) {
+        destino[0] = (char) relleno;
+    }
+}
+
+// Los kernels de tamaño devuelven el tamaño transformado y suman en
+// '*rellenos' los bytes de relleno que tendrá la salida del fragmento: los
+// que generan los dígitos más los que ya venían en la entrada. El contador es
+// de 64 bits en cualquier plataforma: con 32 se desborda a partir de ~4 G.
+static size_t tamaño_escalar(const char *entrada, size_t n, uint64_t *rellenos) {
+    size_t tamaño = 0;
+    uint64_t cuenta = 0;
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char) entrada[i];
+        tamaño += tabla.expansion[c];
+        cuenta += tabla.rellenos[c];
+    }
+    *rellenos += cuenta;
+    return tamaño;
+}
+
+// Transforma [entrada, entrada + n) escribiendo solo lo que pide 'modo';
+// devuelve cuántos bytes de salida ocupa el fragmento
+static size_t transformar_escalar(const char *entrada, size_t n, char *salida, int modo) {
+    size_t pos_salida = 0;
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char) entrada[i];
+        unsigned expansion = tabla.expansion[c];
+        if (modo & tabla.clase[c]) {
+            if (expansion == 1)
+                salida[pos_salida] = (char) tabla.byte[c];
+            else
+                escribir_relleno(salida + pos_salida, expansion, tabla.byte[c]);
+        }
+        pos_salida += expansion;
+    }
+    return pos_salida;
+}
+
+// Bloque vectorial que contiene algún dígito: 'convertido' es el bloque con
+// las letras ya transformadas y 'mascara' marca las posiciones con dígito. Los
+// tramos sin dígitos se copian de una vez y cada dígito se expande en su sitio.
+static inline __attribute__((always_inline))
+size_t expandir_bloque(const unsigned char *convertido, const char *original, unsigned ancho,
+                       uint32_t mascara, char *salida, int modo, unsigned char relleno) {
+    size_t pos_salida = 0;
+    unsigned inicio = 0;
+    while (mascara) {
+        unsigned j = (unsigned) __builtin_ctz(mascara);
+        mascara &= mascara - 1;
+        if (modo & KAIO_MODO_TEXTO)
+            memcpy(salida + pos_salida, convertido + inicio, j - inicio);
+        pos_salida += j - inicio;
+        unsigned num_rellenos = (unsigned char) original[j] - '0';
+        if (modo & KAIO_MODO_ASTERISCOS)
+            escribir_relleno(salida + pos_salida, num_rellenos, relleno);
+        pos_salida += num_rellenos;
+        inicio = j + 1;
+    }
+    if (modo & KAIO_MODO_TEXTO)
+        memcpy(salida + pos_salida, convertido + inicio, ancho - inicio);
+    return pos_salida + (ancho - inicio);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Kernels genéricos: solo se usan a través de DEFINIR_KERNELS, que los
+// instancia con unas reglas concretas. Las comparaciones son con signo: los
+// bytes >= 0x80 son negativos y nunca caen en '0'..'9' ni en las letras.
+
+__attribute__((target("sse2"), always_inline))
+static inline __m128i letras_sse2(__m128i v, struct kaio_reglas r) {
+    if (r.letras == KAIO_LETRAS_IGUAL)
+        return v;
+    char primera = r.letras == KAIO_LETRAS_MAYUSCULAS ? 'a' : 'A';
+    __m128i en_rango = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((char)(primera - 1))),
+                                     _mm_cmpgt_epi8(_mm_set1_epi8((char)(primera + 26)), v));
+    __m128i diferencia = _mm_and_si128(en_rango, _mm_set1_epi8('a' - 'A'));
+    return r.letras == KAIO_LETRAS_MAYUSCULAS ? _mm_sub_epi8(v, diferencia) : _mm_add_epi8(v, diferencia);
+}
+
+__attribute__((target("sse2"), always_inline))
+static inline __m128i digitos_sse2(__m128i v, struct kaio_reglas r) {
+    if (r.digitos != KAIO_DIGITOS_EXPANDIR)
+        return _mm_setzero_si128();
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), v));
+}
+
+__attribute__((target("sse2"), always_inline))
+static inline size_t tamaño_sse2(const char *entrada, size_t n, uint64_t *rellenos, struct kaio_reglas r) {
+    const __m128i cero_ascii = _mm_set1_epi8('0'), unos = _mm_set1_epi8(1);
+    const __m128i relleno = _mm_set1_epi8((char) r.relleno);
+    __m128i suma_digitos = _mm_setzero_si128();
+    __m128i otros = _mm_setzero_si128();
+    __m128i copiados = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(entrada + i));
+        __m128i digitos = digitos_sse2(v, r);
+        // valor de cada dígito (0 en el resto) y 1 por cada byte que no es dígito
+        if (r.digitos == KAIO_DIGITOS_EXPANDIR) {
+            __m128i valores = _mm_and_si128(digitos, _mm_sub_epi8(v, cero_ascii));
+            suma_digitos = _mm_add_epi64(suma_digitos, _mm_sad_epu8(valores, _mm_setzero_si128()));
+        }
+        otros = _mm_add_epi64(otros, _mm_sad_epu8(_mm_andnot_si128(digitos, unos), _mm_setzero_si128()));
+        // bytes copiados que salen como relleno; si el relleno no es una letra
+        // basta con mirar la entrada
+        __m128i salida = es_letra(r.relleno) ? letras_sse2(v, r) : v;
+        __m128i es_relleno = _mm_andnot_si128(digitos, _mm_and_si128(_mm_cmpeq_epi8(salida, relleno), unos));
+        copiados = _mm_add_epi64(copiados, _mm_sad_epu8(es_relleno, _mm_setzero_si128()));
+    }
+    uint64_t parciales[2], parciales_otros[2], parciales_copiados[2];
+    _mm_storeu_si128((__m128i *)parciales, suma_digitos);
+    _mm_storeu_si128((__m128i *)parciales_otros, otros);
+    _mm_storeu_si128((__m128i *)parciales_copiados, copiados);
+    size_t suma = (size_t)(parciales[0] + parciales[1]);
+    *rellenos += parciales[0] + parciales[1] + parciales_copiados[0] + parciales_copiados[1];
+    return suma + (size_t)(parciales_otros[0] + parciales_otros[1])
+         + tamaño_escalar(entrada + i, n - i, rellenos);
+}
+
+__attribute__((target("sse2"), always_inline))
+static inline size_t transformar_sse2(const char *entrada, size_t n, char *salida, int modo, struct kaio_reglas r) {
+    size_t pos_salida = 0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(entrada + i));
+        __m128i convertido = letras_sse2(v, r);
+        uint32_t mascara = (uint32_t) _mm_movemask_epi8(digitos_sse2(v, r));
+        if (mascara == 0) {
+            if (modo & KAIO_MODO_TEXTO)
+                _mm_storeu_si128((__m128i *)(salida + pos_salida), convertido);
+            pos_salida += 16;
+        } else {
+            unsigned char bloque[16];
+            _mm_storeu_si128((__m128i *)bloque, convertido);
+            pos_salida += expandir_bloque(bloque, entrada + i, 16, mascara, salida + pos_salida, modo, r.relleno);
+        }
+    }
+    return pos_salida + transformar_escalar(entrada + i, n - i, salida + pos_salida, modo);
+}
+
+__attribute__((target("avx2"), always_inline))
+static inline __m256i letras_avx2(__m256i v, struct kaio_reglas r) {
+    if (r.letras == KAIO_LETRAS_IGUAL)
+        return v;
+    char primera = r.letras == KAIO_LETRAS_MAYUSCULAS ? 'a' : 'A';
+    __m256i en_rango = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8((char)(primera - 1))),
+                                        _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(primera + 26)), v));
+    __m256i diferencia = _mm256_and_si256(en_rango, _mm256_set1_epi8('a' - 'A'));
+    return r.letras == KAIO_LETRAS_MAYUSCULAS ? _mm256_sub_epi8(v, diferencia) : _mm256_add_epi8(v, diferencia);
+}
+
+__attribute__((target("avx2"), always_inline))
+static inline __m256i digitos_avx2(__m256i v, struct kaio_reglas r) {
+    if (r.digitos != KAIO_DIGITOS_EXPANDIR)
+        return _mm256_setzero_si256();
+    return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+}
+
+__attribute__((target("avx2"), always_inline))
+static inline size_t tamaño_avx2(const char *entrada, size_t n, uint64_t *rellenos, struct kaio_reglas r) {
+    const __m256i cero_ascii = _mm256_set1_epi8('0'), unos = _mm256_set1_epi8(1);
+    const __m256i relleno = _mm256_set1_epi8((char) r.relleno);
+    __m256i suma_digitos = _mm256_setzero_si256();
+    __m256i otros = _mm256_setzero_si256();
+    __m256i copiados = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(entrada + i));
+        __m256i digitos = digitos_avx2(v, r);
+        if (r.digitos == KAIO_DIGITOS_EXPANDIR) {
+            __m256i valores = _mm256_and_si256(digitos, _mm256_sub_epi8(v, cero_ascii));
+            suma_digitos = _mm256_add_epi64(suma_digitos, _mm256_sad_epu8(valores, _mm256_setzero_si256()));
+        }
+        otros = _mm256_add_epi64(otros, _mm256_sad_epu8(_mm256_andnot_si256(digitos, unos), _mm256_setzero_si256()));
+        __m256i salida = es_letra(r.relleno) ? letras_avx2(v, r) : v;
+        __m256i es_relleno = _mm256_andnot_si256(digitos, _mm256_and_si256(_mm256_cmpeq_epi8(salida, relleno), unos));
+        copiados = _mm256_add_epi64(copiados, _mm256_sad_epu8(es_relleno, _mm256_setzero_si256()));
+    }
+    uint64_t parciales[4], parciales_otros[4], parciales_copiados[4];
+    _mm256_storeu_si256((__m256i *)parciales, suma_digitos);
+    _mm256_storeu_si256((__m256i *)parciales_otros, otros);
+    _mm256_storeu_si256((__m256i *)parciales_copiados, copiados);
+    size_t suma = (size_t)(parciales[0] + parciales[1] + parciales[2] + parciales[3]);
+    *rellenos += parciales[0] + parciales[1] + parciales[2] + parciales[3]
+               + parciales_copiados[0] + parciales_copiados[1] + parciales_copiados[2] + parciales_copiados[3];
+    return suma + (size_t)(parciales_otros[0] + parciales_otros[1] + parciales_otros[2] + parciales_otros[3])
+         + tamaño_escalar(entrada + i, n - i, rellenos);
+}
+
+__attribute__((target("avx2"), always_inline))
+static inline size_t transformar_avx2(const char *entrada, size_t n, char *salida, int modo, struct kaio_reglas r) {
+    size_t pos_salida = 0;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(entrada + i));
+        __m256i convertido = letras_avx2(v, r);
+        uint32_t mascara = (uint32_t) _mm256_movemask_epi8(digitos_avx2(v, r));
+        if (mascara == 0) {
+            if (modo & KAIO_MODO_TEXTO)
+                _mm256_storeu_si256((__m256i *)(salida + pos_salida), convertido);
+            pos_salida += 32;
+        } else {
+            unsigned char bloque[32];
+            _mm256_storeu_si256((__m256i *)bloque, convertido);
+            pos_salida += expandir_bloque(bloque, entrada + i, 32, mascara, salida + pos_salida, modo, r.relleno);
+        }
+    }
+    return pos_salida + transformar_escalar(entrada + i, n - i, salida + pos_salida, modo);
+}
+
+// Genera los cuatro kernels vectoriales de un conjunto de reglas
+#define DEFINIR_KERNELS_CON(nombre, reglas) \
+    __attribute__((target("sse2"))) \
+    static size_t tamaño_sse2_##nombre(const char *entrada, size_t n, uint64_t *rellenos) { \
+        return tamaño_sse2(entrada, n, rellenos, reglas); \
+    } \
+    __attribute__((target("sse2"))) \
+    static size_t transformar_sse2_##nombre(const char *entrada, size_t n, char *salida, int modo) { \
+        return transformar_sse2(entrada, n, salida, modo, reglas); \
+    } \
+    __attribute__((target("avx2"))) \
+    static size_t tamaño_avx2_##nombre(const char *entrada, size_t n, uint64_t *rellenos) { \
+        return tamaño_avx2(entrada, n, rellenos, reglas); \
+    } \
+    __attribute__((target("avx2"))) \
+    static size_t transformar_avx2_##nombre(const char *entrada, size_t n, char *salida, int modo) { \
+        return transformar_avx2(entrada, n, salida, modo, reglas); \
+    }
+
+#define DEFINIR_KERNELS(nombre, relleno_, letras_, digitos_) \
+    DEFINIR_KERNELS_CON(nombre, ((struct kaio_reglas){ .relleno = relleno_, .letras = letras_, .digitos = digitos_ }))
+
+LISTA_REGLAS(DEFINIR_KERNELS)
+DEFINIR_KERNELS_CON(personalizadas, reglas_activas)
+
+#define KERNELS_SIMD(nombre) \
+    , tamaño_sse2_##nombre, transformar_sse2_##nombre, tamaño_avx2_##nombre, transformar_avx2_##nombre
+#else
+#define KERNELS_SIMD(nombre)
+#endif
+
+typedef size_t (*kernel_tamaño_t)(const char *entrada, size_t n, uint64_t *rellenos);
+typedef size_t (*kernel_transformar_t)(const char *entrada, size_t n, char *salida, int modo);
+
+struct conjunto_reglas {
+    const char *nombre;
+    struct kaio_reglas reglas;
+#if defined(__x86_64__) || defined(__i386__)
+    kernel_tamaño_t tamaño_sse2;
+    kernel_transformar_t transformar_sse2;
+    kernel_tamaño_t tamaño_avx2;
+    kernel_transformar_t transformar_avx2;
+#endif
+};
+
+#define ENTRADA_CONJUNTO(nombre, relleno_, letras_, digitos_) \
+    { #nombre, { .relleno = relleno_, .letras = letras_, .digitos = digitos_ } KERNELS_SIMD(nombre) },
+
+static const struct conjunto_reglas conjuntos[] = {
+    LISTA_REGLAS(ENTRADA_CONJUNTO)
+};
+static const struct conjunto_reglas personalizadas = { "personalizadas", { 0 } KERNELS_SIMD(personalizadas) };
+
+// Kernels elegidos al cargar la biblioteca y al cambiar de reglas (los hijos
+// los heredan con fork)
+#define NIVEL_ESCALAR   0
+#define NIVEL_SSE2      1
+#define NIVEL_AVX2      2
+
+static int nivel_kernel = NIVEL_ESCALAR;
+static kernel_tamaño_t kernel_tamaño = tamaño_escalar;
+static kernel_transformar_t kernel_transformar = transformar_escalar;
+static const char *nombre_kernel = "escalar";
+static const char *nombre_reglas = "asteriscos";
+
+static void elegir_conjunto(const struct conjunto_reglas *conjunto) {
+    nombre_reglas = conjunto->nombre;
+    kernel_tamaño = tamaño_escalar;
+    kernel_transformar = transformar_escalar;
+#if defined(__x86_64__) || defined(__i386__)
+    if (nivel_kernel == NIVEL_AVX2) {
+        kernel_tamaño = conjunto->tamaño_avx2;
+        kernel_transformar = conjunto->transformar_avx2;
+    } else if (nivel_kernel == NIVEL_SSE2) {
+        kernel_tamaño = conjunto->tamaño_sse2;
+        kernel_transformar = conjunto->transformar_sse2;
+    }
+#endif
+}
+
+// Elige el mejor kernel que soporte la CPU. La variable de entorno
+// KAIO_KERNEL=escalar|sse2|avx2 permite forzar uno concreto para comparar.
+__attribute__((constructor))
+static void elegir_kernels(void) {
+    const char *forzado = getenv("KAIO_KERNEL");
+#if defined(__x86_64__) || defined(__i386__)
+    if (forzado == NULL || strcmp(forzado, "escalar") != 0) {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && (forzado == NULL || strcmp(forzado, "avx2") == 0)) {
+            nivel_kernel = NIVEL_AVX2;
+            nombre_kernel = "avx2";
+        } else if (__builtin_cpu_supports("sse2")) {
+            nivel_kernel = NIVEL_SSE2;
+            nombre_kernel = "sse2";
+        }
+    }
+#else
+    (void) forzado;
+#endif
+    kaio_usar_reglas(&conjuntos[0].reglas);
+}
+
+// --- API PÚBLICA ---
+
+size_t kaio_medir(const char *entrada, size_t n, uint64_t *asteriscos) {
+    return kernel_tamaño(entrada, n, asteriscos);
+}
+
+size_t kaio_transformar(const char *entrada, size_t n, char *salida) {
+    return kernel_transformar(entrada, n, salida, KAIO_MODO_COMPLETO);
+}
+
+size_t kaio_transformar_modo(const char *entrada, size_t n, char *salida, int modo) {
+    return kernel_transformar(entrada, n, salida, modo);
+}
+
+// snprintf termina en '\0', que no es parte del footer: se formatea aparte y
+// se copia solo el footer, para que baste un buffer de kaio_medir_todo bytes
+int kaio_footer(char *buffer, uint64_t asteriscos) {
+    char footer[KAIO_MAX_FOOTER];
+    int n = snprintf(footer, sizeof(footer), "\nTotal asteriscos: %" PRIu64 "\n", asteriscos);
+    memcpy(buffer, footer, (size_t) n);
+    return n;
+}
+
+size_t kaio_medir_todo(const char *entrada, size_t n) {
+    uint64_t asteriscos = 0;
+    size_t tamaño = kaio_medir(entrada, n, &asteriscos);
+    char footer[KAIO_MAX_FOOTER];
+    return tamaño + (size_t) kaio_footer(footer, asteriscos);
+}
+
+size_t kaio_convertir(const char *entrada, size_t n, char *salida) {
+    struct kaio_estado estado;
+    kaio_iniciar(&estado);
+    size_t escritos = kaio_procesar(&estado, entrada, n, salida);
+    return escritos + kaio_terminar(&estado, salida + escritos);
+}
+
+void kaio_iniciar(struct kaio_estado *estado) {
+    estado->asteriscos = 0;
+    estado->bytes_entrada = 0;
+    estado->bytes_salida = 0;
+}
+
+size_t kaio_procesar(struct kaio_estado *estado, const char *entrada, size_t n, char *salida) {
+    // la transformación no depende de lo anterior: cada trozo se mide y se
+    // transforma por separado, el estado solo lleva las cuentas
+    kernel_tamaño(entrada, n, &estado->asteriscos);
+    size_t escritos = kernel_transformar(entrada, n, salida, KAIO_MODO_COMPLETO);
+    estado->bytes_entrada += n;
+    estado->bytes_salida += escritos;
+    return escritos;
+}
+
+size_t kaio_terminar(struct kaio_estado *estado, char *salida) {
+    size_t escritos = (size_t) kaio_footer(salida, estado->asteriscos);
+    estado->bytes_salida += escritos;
+    return escritos;
+}
+
+const char *kaio_kernel(void) {
+    return nombre_kernel;
+}
+
+int kaio_usar_reglas(const struct kaio_reglas *reglas) {
+    if (reglas->letras < KAIO_LETRAS_IGUAL || reglas->letras > KAIO_LETRAS_MINUSCULAS ||
+        (reglas->digitos != KAIO_DIGITOS_IGUAL && reglas->digitos != KAIO_DIGITOS_EXPANDIR))
+        return -1;
+
+    // los conjuntos de la lista tienen kernels propios; el resto usa los
+    // genéricos, que leen las reglas de reglas_activas
+    const struct conjunto_reglas *conjunto = &personalizadas;
+    for (size_t i = 0; i < sizeof(conjuntos) / sizeof(conjuntos[0]); i++) {
+        const struct kaio_reglas *r = &conjuntos[i].reglas;
+        if (r->relleno == reglas->relleno && r->letras == reglas->letras && r->digitos == reglas->digitos) {
+            conjunto = &conjuntos[i];
+            break;
+        }
+    }
+    reglas_activas = *reglas;
+    compilar_reglas(reglas, &tabla);
+    elegir_conjunto(conjunto);
+    return 0;
+}
+
+const struct kaio_reglas *kaio_buscar_reglas(const char *nombre) {
+    for (size_t i = 0; i < sizeof(conjuntos) / sizeof(conjuntos[0]); i++) {
+        if (strcmp(conjuntos[i].nombre, nombre) == 0)
+            return &conjuntos[i].reglas;
+    }
+    return NULL;
+}
+
+const char *kaio_nombre_reglas(void) {
+    return nombre_reglas;
+}
+
+const struct kaio_reglas *kaio_reglas_activas(void) {
+    return &reglas_activas;
+}
+
+// --- FORMATO RLE ---
+// Se codifica directamente desde la entrada con la tabla de reglas, sin
+// expandir los dígitos: un byte cuya tabla da el relleno (un dígito o el
+// propio relleno) alarga la racha y cualquier otro es un literal. Los
+// literales se escriben directamente en la salida, en grupos que se cierran
+// al final de cada llamada; la racha pendiente pasa a la siguiente, pero
+// nunca con más de 128 bytes, así que cada llamada escribe como mucho
+// KAIO_MAX_RLE(n) bytes. Una racha de un solo byte cuesta menos como literal.
+
+struct escritor_rle {
+    unsigned char *pos;
+    unsigned char *grupo;       // byte de control del grupo de literales abierto, o NULL
+    unsigned n_grupo;
+};
+
+static inline void cerrar_grupo(struct escritor_rle *e) {
+    if (e->grupo != NULL) {
+        *e->grupo = (unsigned char)(e->n_grupo - 1);
+        e->grupo = NULL;
+    }
+}
+
+static inline void escribir_literales(struct escritor_rle *e, const unsigned char *bytes, size_t n) {
+    while (n > 0) {
+        if (e->grupo == NULL || e->n_grupo == 128) {
+            cerrar_grupo(e);
+            e->grupo = e->pos++;
+            e->n_grupo = 0;
+        }
+        size_t k = 128 - e->n_grupo < n ? 128 - e->n_grupo : n;
+        memcpy(e->pos, bytes, k);
+        e->pos += k;
+        e->n_grupo += (unsigned) k;
+        bytes += k;
+        n -= k;
+    }
+}
+
+// Escribe la racha pendiente dejando como mucho 'resto' bytes sin escribir
+static void escribir_racha(struct escritor_rle *e, uint64_t *racha, uint64_t resto, unsigned char relleno) {
+    while (*racha > resto && *racha >= 2) {
+        uint64_t k = *racha < 128 ? *racha : 128;
+        cerrar_grupo(e);
+        *e->pos++ = (unsigned char)(0x80 | (k - 1));
+        *e->pos++ = relleno;
+        *racha -= k;
+    }
+    if (*racha == 1 && resto == 0) {
+        *racha = 0;
+        escribir_literales(e, &relleno, 1);
+    }
+}
+
+void kaio_rle_iniciar(struct kaio_rle *rle) {
+    kaio_iniciar(&rle->estado);
+    rle->bytes_normales = 0;
+    rle->racha = 0;
+    rle->cabecera = 0;
+}
+
+size_t kaio_rle_procesar(struct kaio_rle *rle, const char *entrada, size_t n, char *salida) {
+    struct escritor_rle e = { (unsigned char *) salida, NULL, 0 };
+    unsigned char relleno = reglas_activas.relleno;
+    if (!rle->cabecera) {
+        memcpy(e.pos, KAIO_RLE_MAGIA, 8);
+        e.pos += 8;
+        rle->cabecera = 1;
+    }
+    uint64_t racha = rle->racha, asteriscos = 0, normales = 0;
+    const unsigned char *p = (const unsigned char *) entrada, *fin = p + n;
+    while (p < fin) {
+        // racha: dígitos expandidos y bytes que se copian como relleno (en
+        // los dos casos la tabla da el relleno; un '0' no genera nada)
+        uint64_t nuevos = 0;
+        while (p < fin && tabla.byte[*p] == relleno) {
+            nuevos += tabla.expansion[*p];
+            p++;
+        }
+        racha += nuevos;
+        asteriscos += nuevos;
+        normales += nuevos;
+        if (p == fin)
+            break;
+        if (racha > 0)
+            escribir_racha(&e, &racha, 0, relleno);
+        // tramo literal, en grupos de hasta 128 bytes
+        while (p < fin && tabla.byte[*p] != relleno) {
+            if (e.grupo == NULL || e.n_grupo == 128) {
+                cerrar_grupo(&e);
+                e.grupo = e.pos++;
+                e.n_grupo = 0;
+            }
+            unsigned char *inicio = e.pos;
+            const unsigned char *limite = fin - p < 128 - e.n_grupo ? fin : p + (128 - e.n_grupo);
+            unsigned char b;
+            while (p < limite && (b = tabla.byte[*p]) != relleno) {
+                *e.pos++ = b;
+                p++;
+            }
+            e.n_grupo += (unsigned)(e.pos - inicio);
+            normales += (uint64_t)(e.pos - inicio);
+        }
+    }
+    escribir_racha(&e, &racha, 128, relleno);
+    cerrar_grupo(&e);
+    rle->racha = racha;
+    rle->estado.asteriscos += asteriscos;
+    rle->estado.bytes_entrada += n;
+    rle->bytes_normales += normales;
+    size_t escritos = (size_t)(e.pos - (unsigned char *) salida);
+    rle->estado.bytes_salida += escritos;
+    return escritos;
+}
+
+size_t kaio_rle_terminar(struct kaio_rle *rle, char *salida) {
+    struct escritor_rle e = { (unsigned char *) salida, NULL, 0 };
+    if (!rle->cabecera) {
+        memcpy(e.pos, KAIO_RLE_MAGIA, 8);
+        e.pos += 8;
+        rle->cabecera = 1;
+    }
+    char footer[KAIO_MAX_FOOTER];
+    int tam_contador = kaio_footer(footer, rle->estado.asteriscos);
+    rle->bytes_normales += (uint64_t) tam_contador;
+    escribir_racha(&e, &rle->racha, 0, reglas_activas.relleno);
+    escribir_literales(&e, (const unsigned char *) footer, (size_t) tam_contador);
+    cerrar_grupo(&e);
+    size_t escritos = (size_t)(e.pos - (unsigned char *) salida);
+    rle->estado.bytes_salida += escritos;
+    return escritos;
+}
+
+size_t kaio_rle_tamaño(const char *rle, size_t n) {
+    const unsigned char *p = (const unsigned char *) rle;
+    if (n < 8 || memcmp(p, KAIO_RLE_MAGIA, 8) != 0)
+        return (size_t)-1;
+    size_t tamaño = 0;
+    size_t i = 8;
+    while (i < n) {
+        unsigned control = p[i];
+        size_t k = (control & 0x7f) + 1;
+        size_t ocupa = control & 0x80 ? 2 : 1 + k;
+        if (ocupa > n - i)
+            return (size_t)-1;
+        tamaño += k;
+        i += ocupa;
+    }
+    return tamaño;
+}
+
+size_t kaio_rle_decodificar(const char *rle, size_t n, char *salida) {
+    const unsigned char *p = (const unsigned char *) rle;
+    size_t pos_salida = 0;
+    size_t i = 8;
+    while (i < n) {
+        unsigned control = p[i];
+        size_t k = (control & 0x7f) + 1;
+        if (control & 0x80) {
+            memset(salida + pos_salida, p[i + 1], k);
+            i += 2;
+        } else {
+            memcpy(salida + pos_salida, p + i + 1, k);
+            i += 1 + k;
+        }
+        pos_salida += k;
+    }
+    return pos_salida;
+}
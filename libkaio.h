@@ -0,0 +1,118 @@
+#ifndef LIBKAIO_H
+#define LIBKAIO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Transformación de kaio sobre buffers en memoria, sin procesos ni archivos:
+// las letras ASCII minúsculas pasan a mayúsculas, cada dígito d se convierte
+// en d asteriscos y el resto de bytes se copia tal cual. La salida completa
+// termina con el footer "\nTotal asteriscos: N\n", donde N cuenta los '*' de
+// la salida (los generados por los dígitos y los que ya traía la entrada).
+// Con kaio_usar_reglas se cambian el relleno y lo que se hace con letras y
+// dígitos; el footer cuenta entonces los bytes de relleno de la salida.
+// El kernel (escalar, SSE2 o AVX2) se elige al cargar la biblioteca; la
+// variable de entorno KAIO_KERNEL=escalar|sse2|avx2 lo fuerza.
+
+#define KAIO_MODO_TEXTO         1   // letras y resto de caracteres no expandidos
+#define KAIO_MODO_ASTERISCOS    2   // dígitos -> relleno
+#define KAIO_MODO_COMPLETO      (KAIO_MODO_TEXTO | KAIO_MODO_ASTERISCOS)
+
+#define KAIO_MAX_FOOTER         64
+#define KAIO_MAX_SALIDA(n)      ((n) * 9)   // peor caso de kaio_transformar: todo '9'
+
+// Tamaño transformado de [entrada, entrada + n), sin footer. Suma en
+// '*asteriscos' los '*' (bytes de relleno) que tendrá esa parte de la salida.
+size_t kaio_medir(const char *entrada, size_t n, uint64_t *asteriscos);
+
+// Transforma [entrada, entrada + n) en 'salida', que debe tener sitio para
+// kaio_medir() bytes; devuelve los bytes escritos
+size_t kaio_transformar(const char *entrada, size_t n, char *salida);
+
+// Como kaio_transformar, pero solo escribe lo que pide 'modo' (KAIO_MODO_*).
+// Los huecos que no se escriben conservan su contenido: así dos llamadas con
+// modos complementarios pueden repartirse el trabajo sobre la misma salida.
+size_t kaio_transformar_modo(const char *entrada, size_t n, char *salida, int modo);
+
+// Escribe el footer (como mucho KAIO_MAX_FOOTER bytes, sin '\0') y devuelve su longitud
+int kaio_footer(char *buffer, uint64_t asteriscos);
+
+// Tamaño de la salida completa (con footer) y transformación de una vez
+size_t kaio_medir_todo(const char *entrada, size_t n);
+size_t kaio_convertir(const char *entrada, size_t n, char *salida);
+
+// API incremental: la entrada se entrega en trozos de cualquier tamaño y cada
+// llamada escribe la salida de su trozo (como mucho KAIO_MAX_SALIDA(n) bytes)
+// y actualiza la cuenta de asteriscos. kaio_terminar escribe el footer.
+struct kaio_estado {
+    uint64_t asteriscos;    // '*' de la salida producida hasta ahora
+    uint64_t bytes_entrada;
+    uint64_t bytes_salida;
+};
+
+void kaio_iniciar(struct kaio_estado *estado);
+size_t kaio_procesar(struct kaio_estado *estado, const char *entrada, size_t n, char *salida);
+size_t kaio_terminar(struct kaio_estado *estado, char *salida);
+
+// Nombre del kernel en uso: "escalar", "sse2" o "avx2"
+const char *kaio_kernel(void);
+
+// Reglas de transformación. Las predefinidas (kaio_buscar_reglas) son
+// "asteriscos" (las de kaio, activas por defecto), "subrayado" (las de
+// Entregable1: '_' en lugar de '*'), "minusculas", "mayusculas" (los dígitos
+// se copian) y "digitos" (las letras se copian). Cada una tiene sus propios
+// kernels vectoriales; cualquier otra combinación también vale, con kernels
+// genéricos algo más lentos.
+#define KAIO_LETRAS_IGUAL       0
+#define KAIO_LETRAS_MAYUSCULAS  1
+#define KAIO_LETRAS_MINUSCULAS  2
+
+#define KAIO_DIGITOS_IGUAL      0   // se copian como cualquier otro byte
+#define KAIO_DIGITOS_EXPANDIR   1   // el dígito d pasa a d bytes de relleno
+
+struct kaio_reglas {
+    unsigned char relleno;
+    int letras;             // KAIO_LETRAS_*
+    int digitos;            // KAIO_DIGITOS_*
+};
+
+// Cambia las reglas de toda la biblioteca; no se puede llamar con una
+// transformación en curso. Devuelve -1 si las reglas no son válidas.
+int kaio_usar_reglas(const struct kaio_reglas *reglas);
+
+// Reglas predefinidas por nombre, o NULL si no existen
+const struct kaio_reglas *kaio_buscar_reglas(const char *nombre);
+
+// Nombre de las reglas activas, "personalizadas" si no son predefinidas
+const char *kaio_nombre_reglas(void);
+
+// Reglas activas
+const struct kaio_reglas *kaio_reglas_activas(void);
+
+// Formato RLE: la misma salida, pero las rachas de relleno se guardan como
+// (cuenta, byte). Empieza con la magia KAIO_RLE_MAGIA (8 bytes) y sigue con
+// tokens que empiezan por un byte de control c:
+//   c < 0x80     c + 1 bytes literales (1..128), que van a continuación
+//   c >= 0x80    (c & 0x7f) + 1 repeticiones (1..128) del byte siguiente
+// El footer va como literales al final, así que descodificar da exactamente
+// la salida normal. La API es incremental, como kaio_procesar.
+#define KAIO_RLE_MAGIA          "KAIORLE1"
+#define KAIO_MAX_RLE(n)         (2 * (n) + 512)   // salida máxima de una llamada
+
+struct kaio_rle {
+    struct kaio_estado estado;  // bytes_salida cuenta bytes RLE; asteriscos, los de la salida normal
+    uint64_t bytes_normales;    // bytes de la salida normal equivalente, footer incluido
+    uint64_t racha;             // relleno pendiente de escribir
+    int cabecera;               // 1 si ya se escribió la magia
+};
+
+void kaio_rle_iniciar(struct kaio_rle *rle);
+size_t kaio_rle_procesar(struct kaio_rle *rle, const char *entrada, size_t n, char *salida);
+size_t kaio_rle_terminar(struct kaio_rle *rle, char *salida);
+
+// Tamaño de la salida normal que representa [rle, rle + n), o (size_t)-1 si
+// no es RLE válido; y descodificación de una vez sobre 'salida'
+size_t kaio_rle_tamaño(const char *rle, size_t n);
+size_t kaio_rle_decodificar(const char *rle, size_t n, char *salida);
+
+#endif
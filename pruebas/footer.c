@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../libkaio.h"
+
+// Comprueba el contrato de libkaio.h: un buffer de exactamente
+// kaio_medir_todo(n) bytes basta para kaio_convertir, y un buffer de
+// KAIO_MAX_FOOTER bytes basta para kaio_terminar. Se compila con
+// -fsanitize=address, así que un solo byte de más hace fallar la prueba.
+
+static int probar(const char *entrada, size_t n) {
+    size_t total = kaio_medir_todo(entrada, n);
+    char *salida = malloc(total);
+    if (salida == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    size_t escritos = kaio_convertir(entrada, n, salida);
+    free(salida);
+    if (escritos != total) {
+        fprintf(stderr, "%s: n=%zu, kaio_convertir escribió %zu bytes y kaio_medir_todo dijo %zu\n",
+                kaio_kernel(), n, escritos, total);
+        return -1;
+    }
+
+    struct kaio_estado estado;
+    kaio_iniciar(&estado);
+    char *cuerpo = malloc(KAIO_MAX_SALIDA(n));
+    char *footer = malloc(KAIO_MAX_FOOTER);
+    if (cuerpo == NULL || footer == NULL) {
+        perror("malloc");
+        free(cuerpo);
+        free(footer);
+        return -1;
+    }
+    size_t incremental = kaio_procesar(&estado, entrada, n, cuerpo);
+    incremental += kaio_terminar(&estado, footer);
+    free(cuerpo);
+    free(footer);
+    if (incremental != total) {
+        fprintf(stderr, "%s: n=%zu, la API incremental escribió %zu bytes en lugar de %zu\n",
+                kaio_kernel(), n, incremental, total);
+        return -1;
+    }
+    return 0;
+}
+
+int main(void) {
+    // footers de longitudes distintas: 0, 9, 10 y muchos asteriscos
+    static const char *const casos[] = { "", "a", "abc", "9", "0", "12345", "9999999999", "x9y9z9" };
+    int errores = 0;
+    for (size_t i = 0; i < sizeof(casos) / sizeof(casos[0]); i++)
+        errores += probar(casos[i], strlen(casos[i])) < 0;
+
+    size_t n = 1 << 20;
+    char *grande = malloc(n);
+    if (grande == NULL) {
+        perror("malloc");
+        return 1;
+    }
+    srand(1);
+    for (size_t i = 0; i < n; i++)
+        grande[i] = (char) (rand() % 256);
+    for (size_t m = 1; m <= n; m *= 4)
+        errores += probar(grande, m) < 0;
+    free(grande);
+
+    printf("footer (%s): %s\n", kaio_kernel(), errores == 0 ? "ok" : "FALLO");
+    return errores == 0 ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+#!/bin/sh
+# Comprueba el footer de kaio con una entrada sintética de varios GB. La
+# entrada son solo nueves (bench/generador -l 0 -d 100 con todo el peso en el
+# 9), así que "Total asteriscos" tiene que ser exactamente 9 * TAM. El TAM por
+# defecto, 512M, es la menor potencia de dos con la que el total pasa de 2^32
+# (9 * 512 MiB = 4831838208): falla tanto un int como un contador de 32 bits
+# sin signo, y la salida (4.5 GiB) sigue cabiendo en un disco normal.
+# Se prueban el modo clásico, el paralelo (-j, donde el total se reduce entre
+# trabajadores), el modo por ventanas (-m, con ventanas pequeñas) y la
+# tubería, que no necesita espacio en disco para la salida.
+#
+# Variables: TAM (por defecto 512M; la salida ocupa 9 veces más), DIR e HILOS
+# (para -j; por defecto nproc, y al menos 2 para que haya reducción).
+
+set -e
+
+RAIZ=$(cd "$(dirname "$0")/.." && pwd)
+TAM=${TAM:-512M}
+DIR=${DIR:-/tmp/kaio-pruebas}
+HILOS=${HILOS:-$(nproc)}
+[ "$HILOS" -ge 2 ] || HILOS=2
+
+mkdir -p "$DIR"
+ENTRADA=$DIR/nueves
+SALIDA=$DIR/nueves.out
+trap 'rm -f "$ENTRADA" "$SALIDA"' EXIT
+
+"$RAIZ/bench/generador" -n "$TAM" -l 0 -d 100 -p 0,0,0,0,0,0,0,0,0,1 > "$ENTRADA"
+BYTES=$(wc -c < "$ENTRADA")
+ESPERADO="Total asteriscos: $((9 * BYTES))"
+
+fallos=0
+comprobar() {
+    if [ "$2" = "$ESPERADO" ]; then
+        echo "footer_grande ($1, $BYTES bytes): ok"
+    else
+        echo "footer_grande ($1, $BYTES bytes): FALLO, se esperaba \"$ESPERADO\" y salió \"$2\""
+        fallos=$((fallos + 1))
+    fi
+}
+
+"$RAIZ/kaio" "$ENTRADA" "$SALIDA" > /dev/null
+comprobar "clasico" "$(tail -n 1 "$SALIDA")"
+rm -f "$SALIDA"
+
+"$RAIZ/kaio" -j "$HILOS" "$ENTRADA" "$SALIDA" > /dev/null
+comprobar "-j $HILOS" "$(tail -n 1 "$SALIDA")"
+rm -f "$SALIDA"
+
+"$RAIZ/kaio" -m 16 "$ENTRADA" "$SALIDA" > /dev/null
+comprobar "-m 16" "$(tail -n 1 "$SALIDA")"
+rm -f "$SALIDA"
+
+comprobar "tuberia" "$("$RAIZ/kaio" - - < "$ENTRADA" | tail -n 1)"
+
+[ "$fallos" -eq 0 ]
@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <ctype.h>
+
+// Transformación de referencia, byte a byte con ctype como en Entregable1,
+// para comparar con kaio. Lee la entrada estándar y escribe la salida con su
+// footer:
+//   referencia <relleno> <letras: igual|mayusculas|minusculas> <digitos: expandir|igual>
+// El footer cuenta todos los bytes de relleno de la salida, también los que ya
+// venían en la entrada.
+
+int main(int argc, char *argv[]) {
+    if (argc != 4 || argv[1][0] == '\0' || argv[1][1] != '\0') {
+        fprintf(stderr, "Uso correcto: %s <relleno> <igual|mayusculas|minusculas> <expandir|igual>\n", argv[0]);
+        return 1;
+    }
+    int relleno = (unsigned char) argv[1][0];
+    int mayusculas = argv[2][0] == 'm' && argv[2][1] == 'a';
+    int minusculas = argv[2][0] == 'm' && argv[2][1] == 'i';
+    int expandir = argv[3][0] == 'e';
+
+    uint64_t asteriscos = 0;
+    int c;
+    while ((c = getchar()) != EOF) {
+        if (isdigit(c) && expandir) {
+            for (int i = 0; i < c - '0'; i++)
+                putchar(relleno);
+            asteriscos += (uint64_t) (c - '0');
+            continue;
+        }
+        if (isalpha(c))
+            c = mayusculas ? toupper(c) : minusculas ? tolower(c) : c;
+        putchar(c);
+        asteriscos += c == relleno;
+    }
+    printf("\nTotal asteriscos: %" PRIu64 "\n", asteriscos);
+    return 0;
+}
@@ -0,0 +1,61 @@
+#!/bin/sh
+# Comprueba que las reglas '_' (subrayado, las de Entregable1) y las '*' (las
+# de kaio, por defecto) dan exactamente la salida de pruebas/referencia, con
+# cada kernel (KAIO_KERNEL) y en los modos clásico, -j y tubería. Las entradas
+# son texto, texto con '*' y '_' literales y binario aleatorio.
+#
+# Variables: TAM (por defecto 4M) y DIR. Si algo falla, se deja la entrada.
+
+set -e
+
+RAIZ=$(cd "$(dirname "$0")/.." && pwd)
+TAM=${TAM:-4M}
+DIR=${DIR:-/tmp/kaio-pruebas}
+KERNELS=${KERNELS:-"escalar sse2 avx2"}
+
+mkdir -p "$DIR"
+"$RAIZ/bench/generador" -n "$TAM" -s 1 > "$DIR/texto"
+# los rellenos de las dos reglas ya en la entrada, junto a dígitos y letras
+"$RAIZ/bench/generador" -n "$TAM" -s 2 -l 40 -d 30 | tr '.,;:' '*_*_' > "$DIR/literales"
+head -c "$TAM" /dev/urandom > "$DIR/binario"
+
+# reglas|argumentos de pruebas/referencia
+REGLAS="
+asteriscos|* mayusculas expandir
+subrayado|_ mayusculas expandir
+"
+
+fallos=0
+for entrada in texto literales binario; do
+    echo "$REGLAS" | while IFS='|' read -r reglas argumentos; do
+        [ -n "$reglas" ] || continue
+        set -f
+        "$RAIZ/pruebas/referencia" $argumentos < "$DIR/$entrada" > "$DIR/$entrada.$reglas.ref"
+        set +f
+    done
+    for kernel in $KERNELS; do
+        for reglas in asteriscos subrayado; do
+            ESPERADO=$DIR/$entrada.$reglas.ref
+            SALIDA=$DIR/$entrada.$reglas.out
+            for modo in clasico j tuberia; do
+                case $modo in
+                clasico) KAIO_KERNEL=$kernel "$RAIZ/kaio" --reglas=$reglas "$DIR/$entrada" "$SALIDA" > /dev/null ;;
+                j)       KAIO_KERNEL=$kernel "$RAIZ/kaio" --reglas=$reglas -j 3 "$DIR/$entrada" "$SALIDA" > /dev/null ;;
+                tuberia) KAIO_KERNEL=$kernel "$RAIZ/kaio" --reglas=$reglas - - < "$DIR/$entrada" > "$SALIDA" ;;
+                esac
+                if cmp -s "$SALIDA" "$ESPERADO"; then
+                    rm -f "$SALIDA"
+                else
+                    echo "reglas: FALLO $reglas, kernel $kernel, modo $modo, entrada $DIR/$entrada"
+                    fallos=$((fallos + 1))
+                fi
+            done
+        done
+    done
+done
+
+if [ "$fallos" -eq 0 ]; then
+    echo "reglas (asteriscos y subrayado; $KERNELS): ok"
+    rm -f "$DIR"/texto* "$DIR"/literales* "$DIR"/binario*
+fi
+[ "$fallos" -eq 0 ]